@@ -3,6 +3,7 @@
 #include <Stage/Processing.hpp>
 #include <Stage/Processing/Parser.hpp>
 #include <Stage/Processing/Tuning.hpp>
+#include <Stage/Processing/ScrollCache.hpp>
 #include <Feature/PixelDiff.hpp>
 #include <Feature/EdgeChangeFraction.hpp>
 #include <Feature/MSSIM.hpp>
@@ -254,9 +255,26 @@ int main(int argc, const char** argv)
 	typedef core::Task<stage::processing::tuning::ORBscroll, 1> ORBscrollTask;
 	core::TaskContainer<ORBscrollTask> orb_scrolls;
 
-	// Create one ORBscroll for each log dates container
-	for (auto sp_log_dates_container : *sp_log_datum_containers.get())
+	// Apply scroll caches of sessions that have been tuned before with identical input and config
+	std::vector<std::uint64_t> scroll_cache_keys(sp_log_datum_containers->size(), 0);
+	std::vector<bool> scroll_cache_keyed(sp_log_datum_containers->size(), false);
+	std::vector<std::shared_ptr<data::LogDatumContainer> > tuned(sp_log_datum_containers->size(), nullptr);
+	for (unsigned int i = 0; i < sp_log_datum_containers->size(); ++i)
 	{
+		auto sp_log_dates_container = sp_log_datum_containers->at(i);
+		scroll_cache_keyed.at(i) = stage::processing::scroll_cache::compute_key(*sp_log_dates_container->get_session().get(), scroll_cache_keys.at(i));
+		if (scroll_cache_keyed.at(i))
+		{
+			tuned.at(i) = stage::processing::scroll_cache::load(sp_log_dates_container, scroll_cache_keys.at(i));
+		}
+	}
+
+	// Create one ORBscroll for each log dates container without scroll cache
+	for (unsigned int i = 0; i < sp_log_datum_containers->size(); ++i)
+	{
+		if (tuned.at(i)) { continue; }
+		auto sp_log_dates_container = sp_log_datum_containers->at(i);
+
 		// Create ORBscroll task
 		auto sp_task = std::make_shared<ORBscrollTask>(
 			VD(nullptr, ) // provide visual debug dump
@@ -272,10 +290,20 @@ int main(int argc, const char** argv)
 	// Report about progress on ORBscroll tasks
 	orb_scrolls.wait_and_report();
 
-	// Collect products for each session
-	for (auto& rsp_orb_scroll : orb_scrolls.get())
+	// Collect products for each session, either from scroll cache or from ORBscroll
+	unsigned int orb_scroll_idx = 0;
+	for (unsigned int i = 0; i < (unsigned int)tuned.size(); ++i)
 	{
-		sp_log_datum_containers->push_back(rsp_orb_scroll->get_product());
+		auto sp_product = tuned.at(i);
+		if (!sp_product)
+		{
+			sp_product = orb_scrolls.get().at(orb_scroll_idx++)->get_product();
+			if (scroll_cache_keyed.at(i))
+			{
+				stage::processing::scroll_cache::store(*sp_product.get(), scroll_cache_keys.at(i)); // store scroll cache for later runs
+			}
+		}
+		sp_log_datum_containers->push_back(sp_product);
 	}
 	
 	// Make containers const (required by walker)
@@ -289,12 +317,27 @@ int main(int argc, const char** argv)
 	for (auto sp_log_datum_container : *sp_log_datum_containers_const)
 	{
 		std::string session = sp_log_datum_container->get_session()->get_id();
-		auto up_walker = std::unique_ptr<util::LogDatesWalker>(new util::LogDatesWalker(sp_log_datum_container->get(), sp_log_datum_container->get_session()->get_webm_path()));
+		auto up_walker = std::unique_ptr<util::LogDatesWalker>(new util::LogDatesWalker(sp_log_datum_container->get(), sp_log_datum_container->get_session()->get_frame_cache(), sp_log_datum_container->get_layer_arena()));
 		core::mt::log_info("Working on: ", session);
 
-		// Walk over frames
-		while (up_walker->step()) // another frame is available
+		// Collect frames that are represented by any stimulus, others are not compared and skipped
+		std::set<int> stimuli_frame_idxs;
+		for (auto& r_stimulus : stimuli)
+		{
+			const auto& r_frame_idxs = r_stimulus.session_frame_idxs[session];
+			stimuli_frame_idxs.insert(r_frame_idxs.lower_bound(0), r_frame_idxs.end());
+		}
+		int skipped_count = (int)up_walker->get_frame_count() - (int)std::distance(stimuli_frame_idxs.begin(), stimuli_frame_idxs.lower_bound((int)up_walker->get_frame_count()));
+		if (skipped_count > 0)
+		{
+			core::mt::log_info("Frames not found in any stimulus: ", skipped_count); // may happen when root layer completely masked by fixed elements etc.
+		}
+
+		// Seek frames in ascending order, so the decoder only moves forward
+		for (int stimulus_frame_idx : stimuli_frame_idxs)
 		{
+			if (!up_walker->seek((unsigned int)stimulus_frame_idx)) { break; } // beyond end of frames
+
 			// Retrieve values for that frame
 			auto sp_log_image = up_walker->get_log_image();
 			int frame_idx = up_walker->get_frame_idx();
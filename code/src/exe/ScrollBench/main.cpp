@@ -0,0 +1,184 @@
+#include <Core/Core.hpp>
+#include <Core/Task.hpp>
+#include <Data/Session.hpp>
+#include <Data/LayerTree.hpp>
+#include <Stage/Processing/Parser.hpp>
+#include <Stage/Processing/Tuning.hpp>
+#include <cxxopts.hpp>
+#include <chrono>
+#include <cmath>
+
+// Benchmark of the descriptor matchers of ORBscroll. Tunes one session with each matcher and compares the
+// tuned scrolling against brute force matching, which is the reference. Row profile estimation is disabled,
+// so every layer pair is estimated by ORB features.
+
+/////////////////////////////////////////////////
+/// Structures
+/////////////////////////////////////////////////
+
+// Result of tuning with one matcher
+struct Result
+{
+	stage::processing::tuning::Matcher matcher;
+	std::shared_ptr<const data::LogDatumContainer> sp_container;
+	double seconds = 0.0;
+};
+
+/////////////////////////////////////////////////
+/// Main
+/////////////////////////////////////////////////
+
+// Main function
+int main(int argc, const char** argv)
+{
+	core::mt::log_info("Welcome to the ScrollBench of VisualStimuliDiscovery!");
+
+	/////////////////////////////////////////////////
+	/// Command line arguments
+	/////////////////////////////////////////////////
+
+	// Variables to fill
+	std::string log_record_dir = "";
+	std::string log_record_id = "";
+	int frame_limit = -1;
+
+	// Create options object
+	cxxopts::Options options("VisualStimuliDiscovery ScrollBench", "Benchmark of scroll estimation matchers of the GazeMining project.");
+
+	// Add options
+	try
+	{
+		options.add_options()
+			("d,directory", "Directory where session is stored, without slash at the end of path.", cxxopts::value<std::string>())
+			("s,session", "Session to be loaded, consisting of a .webm and a .json file", cxxopts::value<std::string>())
+			("f,frames", "Frames to process (-1 means all that are available).", cxxopts::value<int>(frame_limit));
+	}
+	catch (cxxopts::OptionSpecException e)
+	{
+		std::cerr << e.what() << std::endl;
+		return -1;
+	}
+
+	// Retrieve options
+	try
+	{
+		// Parse arguments to options
+		auto result = options.parse(argc, argv);
+
+		// Directory
+		if (result.count("directory"))
+		{
+			log_record_dir = result["directory"].as<std::string>();
+		}
+		else
+		{
+			throw cxxopts::OptionParseException("Directory option is missing!");
+		}
+
+		// Session
+		if (result.count("session"))
+		{
+			log_record_id = result["session"].as<std::string>();
+		}
+		else
+		{
+			throw cxxopts::OptionParseException("Session option is missing!");
+		}
+	}
+	catch (cxxopts::OptionParseException e)
+	{
+		std::cerr << e.what() << std::endl;
+		return -1;
+	}
+
+	// Print log record information
+	core::mt::log_info("Directory: " + log_record_dir);
+	core::mt::log_info("Session: " + log_record_id);
+
+	/////////////////////////////////////////////////
+	/// Parse log record
+	/////////////////////////////////////////////////
+
+	core::mt::log_info("Parse log record...");
+
+	// Load log record into a session
+	auto sp_session = std::make_shared<data::Session>(
+		log_record_id,
+		log_record_dir + "/" + log_record_id + ".webm",
+		log_record_dir + "/" + log_record_id + ".json",
+		frame_limit);
+
+	// Parse the session into log dates
+	typedef core::Task<stage::processing::parser::LogRecord, 1> ParserTask;
+	auto sp_parsing_task = std::make_shared<ParserTask>(
+		VD(nullptr, ) // no visual debug is used
+		sp_session); // session
+	std::shared_ptr<const data::LogDatumContainer> sp_log_datum_container = sp_parsing_task->get_product();
+
+	/////////////////////////////////////////////////
+	/// Tune with each matcher
+	/////////////////////////////////////////////////
+
+	// Brute force comes first, as it is the reference
+	std::vector<Result> results;
+	for (auto matcher : { stage::processing::tuning::Matcher::BruteForce, stage::processing::tuning::Matcher::LSH, stage::processing::tuning::Matcher::Band })
+	{
+		core::mt::log_info("Tune log record with matcher '", stage::processing::tuning::to_string(matcher), "'...");
+
+		stage::processing::tuning::ORBscrollSettings settings;
+		settings.matcher = matcher;
+		settings.fast_scroll = false; // compare matchers on all layer pairs
+
+		// Tune the scrolling of the log dates, one after another so the runtimes are comparable
+		auto start_time = std::chrono::steady_clock::now();
+		typedef core::Task<stage::processing::tuning::ORBscroll, 1> ORBscrollTask;
+		auto sp_tuning_task = std::make_shared<ORBscrollTask>(
+			VD(nullptr, ) // no visual debug is used
+			sp_log_datum_container,
+			settings);
+		Result result;
+		result.matcher = matcher;
+		result.sp_container = sp_tuning_task->get_product(); // waits for tuning
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+		results.push_back(result);
+	}
+
+	/////////////////////////////////////////////////
+	/// Compare against brute force
+	/////////////////////////////////////////////////
+
+	auto sp_reference_arena = results.front().sp_container->get_layer_arena();
+	for (const auto& r_result : results)
+	{
+		// Compare tuned scrolling of each layer, layer trees are identical as tuning only changes scrolling
+		auto sp_arena = r_result.sp_container->get_layer_arena();
+		unsigned int layer_count = 0;
+		unsigned int within_one_count = 0;
+		double error_sum = 0.0;
+		int max_error = 0;
+		unsigned int frame_count = std::min(sp_arena->get_tree_count(), sp_reference_arena->get_tree_count());
+		for (unsigned int frame_idx = 0; frame_idx < frame_count; ++frame_idx)
+		{
+			const auto& r_reference_packs = sp_reference_arena->get_layer_packs(frame_idx);
+			const auto& r_packs = sp_arena->get_layer_packs(frame_idx);
+			for (unsigned int i = 0; i < (unsigned int)std::min(r_packs.size(), r_reference_packs.size()); ++i)
+			{
+				int error = std::abs(r_packs.at(i).sptr->get_scroll_y() - r_reference_packs.at(i).sptr->get_scroll_y());
+				error_sum += (double)error;
+				max_error = std::max(max_error, error);
+				if (error <= 1) { ++within_one_count; }
+				++layer_count;
+			}
+		}
+
+		// Print results of matcher
+		core::mt::log_info(
+			"Matcher '", stage::processing::tuning::to_string(r_result.matcher), "': ",
+			r_result.seconds, " s (", core::misc::to_percentage_str((float)(r_result.seconds / std::max(results.front().seconds, 1e-6))), " of brute force), ",
+			"mean y-scrolling error ", layer_count > 0 ? error_sum / (double)layer_count : 0.0, " px, ",
+			"max error ", max_error, " px, ",
+			core::misc::to_percentage_str(layer_count > 0 ? (float)within_one_count / (float)layer_count : 1.f), " of ", layer_count, " layers within 1 px");
+	}
+
+	return 0;
+}
@@ -7,6 +7,7 @@
 #include <Util/LayerComparator.hpp>
 #include <Stage/Processing/Parser.hpp>
 #include <Stage/Processing/Tuning.hpp>
+#include <Stage/Processing/ScrollCache.hpp>
 #include <Descriptor/Histogram.hpp>
 #include <Descriptor/OCR.hpp>
 #include <Data/Dataset.hpp>
@@ -66,7 +67,7 @@ struct Observation
 	std::shared_ptr<const data::Layer> sp_prev_layer = nullptr; // only stored for outputting view masks
 	int scroll_offset_x = 0;
 	int scroll_offset_y = 0;
-	int scroll_cache_idx = -1; // mapping from scroll cache idx to observation
+	int scroll_cache_idx = -1; // index of observation before observations without overlapping pixels are deleted
 
 	// Classification
 	bool label = false;
@@ -279,9 +280,6 @@ int main(int argc, const char** argv)
 	const std::string pretrain_labels_file_path(std::string(GM_OUT_PATH) + "labels.csv");
 	// Remark: Would be better to store decision tree itself. Yet, this is not possible with Shogun :(
 
-	// Cached estimated scrolling in observations (aka tuning, so it has not to be done everytime)
-	const std::string scroll_cache_file_path(log_record_dir + "/" + log_record_id + "_scroll_cache.csv");
-
 	/////////////////////////////////////////////////
 	/// Parse log record
 	/////////////////////////////////////////////////
@@ -301,9 +299,19 @@ int main(int argc, const char** argv)
 		sp_session); // session
 	auto sp_log_datum_container = sp_parsing_task->get_product(); // parsing is done in thread, "get_product" will lock until thread is finished
 
-	// Improve scrolling, throw away scrolling from json
-	std::ifstream scroll_cache_file(scroll_cache_file_path);
-	if (!scroll_cache_file.is_open()) // no cache available, thus, compute new scrolling
+	// Improve scrolling, throw away scrolling from json. Tuned scrolling is cached, so tuning has not to be done everytime
+	std::uint64_t scroll_cache_key = 0;
+	bool scroll_cache_keyed = stage::processing::scroll_cache::compute_key(*sp_session.get(), scroll_cache_key);
+	std::shared_ptr<data::LogDatumContainer> sp_tuned_container = nullptr;
+	if (scroll_cache_keyed)
+	{
+		sp_tuned_container = stage::processing::scroll_cache::load(sp_log_datum_container, scroll_cache_key);
+	}
+	if (sp_tuned_container)
+	{
+		core::mt::log_info("Scroll cache has been loaded.");
+	}
+	else // no cache available, thus, compute new scrolling
 	{
 		core::mt::log_info("Tune log record (may take a while)...");
 
@@ -312,8 +320,13 @@ int main(int argc, const char** argv)
 		auto sp_tuning_task = std::make_shared<ORBscrollTask>(
 			VD(nullptr, ) // no visual debug is used
 			sp_log_datum_container);
-		sp_log_datum_container = sp_tuning_task->get_product();
+		sp_tuned_container = sp_tuning_task->get_product();
+		if (scroll_cache_keyed)
+		{
+			stage::processing::scroll_cache::store(*sp_tuned_container.get(), scroll_cache_key);
+		}
 	}
+	sp_log_datum_container = sp_tuned_container;
 	
 	////////////////////////////////////////////////
 	/// Store times
@@ -324,9 +337,7 @@ int main(int argc, const char** argv)
 		std::ofstream times_out(log_record_dir + "/" + log_record_id + "_times.csv");
 		
 		util::LogDatesWalker log_dates_walker(
-			core::misc::make_const(sp_log_datum_container->get()), // log dates from container
-			log_record_dir + "/" + log_record_id + ".webm" // path to video of log record
-		);
+			core::misc::make_const(sp_log_datum_container->get())); // log dates from container, times do not require screenshots
 		while (log_dates_walker.step()) // another frame is available
 		{
 			auto time = log_dates_walker.get_log_datum()->get_frame_time();
@@ -350,7 +361,8 @@ int main(int argc, const char** argv)
 		// Create log dates walker
 		util::LogDatesWalker log_dates_walker(
 			core::misc::make_const(sp_log_datum_container->get()), // log dates from container
-			log_record_dir + "/" + log_record_id + ".webm" // path to video of log record
+			sp_session->get_frame_cache(), // decoded video of log record
+			sp_log_datum_container->get_layer_arena() // flat layer trees of log dates
 		);
 
 		// Go over log dates
@@ -361,7 +373,7 @@ int main(int argc, const char** argv)
 			// Retrieve values for that frame
 			auto sp_log_image = log_dates_walker.get_log_image();
 			int frame_idx = log_dates_walker.get_frame_idx();
-			auto layers_to_process = log_dates_walker.get_layer_packs();
+			const auto& layers_to_process = log_dates_walker.get_layer_packs();
 			
 			// Remember count of frames
 			frame_total_count = std::max(frame_total_count, frame_idx+1); // max actually not required as frame_idx should grow incrementally
@@ -429,62 +441,13 @@ int main(int argc, const char** argv)
 	}
 
 	/////////////////////////////////////////////////
-	/// Store or load scroll estimation
+	/// Index observations for the scroll cache map
 	/////////////////////////////////////////////////
 
 	// Remark: further observations might be deleted after this step when there is no overlapping pixel area
-	if (scroll_cache_file.is_open())
-	{
-		std::string line;
-		int i = 0;
-		while (std::getline(scroll_cache_file, line, '\n'))
-		{
-			if (!line.empty())
-			{
-				// Check whether there is still an observation
-				if (i >= (int)observations.size())
-				{
-					core::mt::log_error("Scroll cache does not seem to fit the observations.");
-					return -1;
-				}
-
-				// Load scroll offset for the observation
-				auto tokens = core::misc::tokenize(line);
-				int scroll_offset_x = std::stoi(tokens.at(0));
-				int scroll_offset_y = std::stoi(tokens.at(1));
-				observations.at(i).scroll_offset_x = scroll_offset_x;
-				observations.at(i).scroll_offset_y = scroll_offset_y;
-				observations.at(i).scroll_cache_idx = i;
-				++i;
-			}
-		}
-
-		// Check whether all observations were covered
-		if (i == (int)observations.size())
-		{
-			core::mt::log_info("Scroll cache has been loaded: " + scroll_cache_file_path);
-		}
-		else
-		{
-			core::mt::log_warn("Not all observations could be updated from scroll cache.");
-		}
-	}
-	else
+	for (int i = 0; i < (int)observations.size(); ++i)
 	{
-		// Store scroll cache
-		std::ofstream scroll_cache_out(scroll_cache_file_path);
-		if (scroll_cache_out.is_open())
-		{
-			for (auto& r_obs : observations)
-			{
-				scroll_cache_out << std::to_string(r_obs.scroll_offset_x) << "," << std::to_string(r_obs.scroll_offset_y) << "\n";
-			}
-			core::mt::log_info("Scroll cache has been created: " + scroll_cache_file_path);
-		}
-		else
-		{
-			core::mt::log_info("Scroll cache could not be created: " + scroll_cache_file_path);
-		}
+		observations.at(i).scroll_cache_idx = i;
 	}
 	
 	// TODO: Remove, just added to make computation shorter
@@ -5,7 +5,12 @@
 #include <opencv2/opencv.hpp>
 #include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
 #include <experimental/filesystem>
+#include <atomic>
+#include <random>
 
 #ifdef __linux__ 
 #include <stdio.h>
@@ -15,6 +20,7 @@
 #include <libgen.h>
 #elif _WIN32
 #include <conio.h>
+#include <process.h>
 #endif
 
 namespace fs = std::experimental::filesystem;
@@ -220,6 +226,48 @@ namespace core
 			}
 		}
 		
+		std::string get_config_table(const std::vector<std::string>& path, const std::vector<std::string>& excluded_keys)
+		{
+			// Go down on path
+			std::shared_ptr<const cpptoml::table> sp_table = static_sp_config;
+			for (const auto& r_key : path)
+			{
+				if (!sp_table) { break; }
+				sp_table = sp_table->get_table(r_key);
+			}
+			if (!sp_table)
+			{
+				log_warn("Config: Path not found: " + toml_path(path));
+				return "";
+			}
+
+			// Remove excluded keys from a copy of the table
+			if (!excluded_keys.empty())
+			{
+				auto sp_copy = std::static_pointer_cast<cpptoml::table>(sp_table->clone());
+				for (const auto& r_excluded : excluded_keys)
+				{
+					auto keys = misc::tokenize(r_excluded, '.');
+					if (keys.empty()) { continue; }
+					std::shared_ptr<cpptoml::table> sp_parent = sp_copy;
+					for (int i = 0; i < (int)keys.size() - 1 && sp_parent; ++i)
+					{
+						sp_parent = sp_parent->get_table(keys.at(i));
+					}
+					if (sp_parent && sp_parent->contains(keys.back()))
+					{
+						sp_parent->erase(keys.back());
+					}
+				}
+				sp_table = sp_copy;
+			}
+
+			// Serialize table with its subtables
+			std::ostringstream stream;
+			stream << *sp_table;
+			return stream.str();
+		}
+
 		// Pass float as double
 		template<>
 		float get_config_value<float>(const float& fallback, const std::vector<std::string>& path)
@@ -361,6 +409,40 @@ namespace core
 			});
 		}
 
+		std::uint64_t hash_bytes(const char* p_data, std::size_t size, std::uint64_t hash)
+		{
+			for (std::size_t i = 0; i < size; ++i)
+			{
+				hash ^= static_cast<unsigned char>(p_data[i]);
+				hash *= 1099511628211ull; // FNV prime
+			}
+			return hash;
+		}
+
+		std::string unique_tmp_path(const std::string& path)
+		{
+			// Process id and counter make path unique on this machine, random value guards against shared file systems
+			static std::atomic<unsigned int> counter(0);
+			static const unsigned int random = std::random_device()();
+#ifdef __linux__
+			const long long pid = (long long)getpid();
+#elif _WIN32
+			const long long pid = (long long)_getpid();
+#else
+			const long long pid = 0;
+#endif
+			return path + ".tmp" + std::to_string(pid) + "_" + std::to_string(random) + "_" + std::to_string(counter++);
+		}
+
+		bool stamp_file(const std::string& path, std::uint64_t& r_size, std::int64_t& r_mtime)
+		{
+			std::error_code ec;
+			r_size = (std::uint64_t)fs::file_size(path, ec);
+			if (ec) { return false; }
+			r_mtime = (std::int64_t)fs::last_write_time(path, ec).time_since_epoch().count();
+			return !ec;
+		}
+
 	}
 
 	/////////////////////////////////////////////////
@@ -492,6 +574,28 @@ namespace core
 			}
 		}
 
+		std::vector<std::uint64_t> row_hashes(const cv::Mat& mat)
+		{
+			// Hash words of eight bytes with FNV-1a scheme, remaining bytes one by one
+			std::vector<std::uint64_t> hashes(mat.rows);
+			const std::size_t row_size = (std::size_t)mat.cols * mat.elemSize();
+			for (int y = 0; y < mat.rows; ++y)
+			{
+				const char* p_row = mat.ptr<char>(y);
+				std::uint64_t hash = 14695981039346656037ull;
+				std::size_t i = 0;
+				for (; i + sizeof(std::uint64_t) <= row_size; i += sizeof(std::uint64_t))
+				{
+					std::uint64_t word;
+					std::memcpy(&word, p_row + i, sizeof(std::uint64_t));
+					hash ^= word;
+					hash *= 1099511628211ull; // FNV prime
+				}
+				hashes[y] = core::misc::hash_bytes(p_row + i, row_size - i, hash);
+			}
+			return hashes;
+		}
+
 		cv::Rect covering_rect_bgra(const cv::Mat& mat)
 		{
 			// Go over matrix and search for non-zero alpha values
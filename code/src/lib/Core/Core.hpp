@@ -7,6 +7,7 @@
 #include <sstream>
 #include <thread>
 #include <numeric>
+#include <cstdint>
 
 namespace core
 {
@@ -64,6 +65,10 @@ namespace core
 		// Get value from config singleton
 		template<typename T>
 		T get_config_value(const T& fallback, const std::vector<std::string>& path);
+
+		// Get table of config singleton serialized as toml, e.g., to fingerprint the config of a stage. Excluded keys are given
+		// relative to the table, e.g., "tuning.thread_count", and might be subtables. Empty if path not found
+		std::string get_config_table(const std::vector<std::string>& path, const std::vector<std::string>& excluded_keys = {});
 	}
 
 	// Miscellaneous 
@@ -99,6 +104,16 @@ namespace core
 		
 		// Checks whether string contains only ascii letters
 		bool is_ascii(const std::string& s);
+
+		// Hash bytes with 64 bit FNV-1a. Provide previous hash to continue hashing
+		std::uint64_t hash_bytes(const char* p_data, std::size_t size, std::uint64_t hash = 14695981039346656037ull);
+
+		// Get size and modification time of file as cheap stamp of its content. Returns false if file cannot be accessed
+		bool stamp_file(const std::string& path, std::uint64_t& r_size, std::int64_t& r_mtime);
+
+		// Get path of temporary file next to path, unique among threads and processes. Write there and rename to path, so
+		// concurrent runs never read a partial file
+		std::string unique_tmp_path(const std::string& path);
 	}
 
 	// Math
@@ -127,6 +142,9 @@ namespace core
 		// Concatenate rows and columns to fit source into target considering the given offset
 		void extend(cv::Mat& target, cv::Rect roi);
 
+		// Hash each row of the matrix, equal rows of matrices with equal width and type have equal hashes
+		std::vector<std::uint64_t> row_hashes(const cv::Mat& mat);
+
 		// Calculate rect that covers the non-zero alpha pixels. Return zero'd rect if no non-zero alpha pixels found
 		cv::Rect covering_rect_bgra(const cv::Mat& mat); // assumes 4 channels with each 8 bit depth
 		cv::Rect covering_rect_a(const cv::Mat& mat); // assumes 1 channel with 8 bit depth
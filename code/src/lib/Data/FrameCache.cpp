@@ -0,0 +1,331 @@
+#include "FrameCache.hpp"
+#include <Core/Core.hpp>
+#include <experimental/filesystem>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace fs = std::experimental::filesystem;
+
+const int MEMORY_FRAME_COUNT = core::mt::get_config_value(32, { "general", "frame_cache", "memory_frame_count" });
+const bool SPILL = core::mt::get_config_value(false, { "general", "frame_cache", "spill" });
+const std::string SPILL_DIRECTORY = core::mt::get_config_value(std::string(""), { "general", "frame_cache", "spill_directory" });
+const bool FRAME_TIME_INDEX = core::mt::get_config_value(true, { "general", "frame_cache", "frame_time_index" });
+
+// Sidecar index of frame times
+const std::string FRAME_TIME_INDEX_SUFFIX = ".times";
+const char FRAME_TIME_INDEX_MAGIC[4] = { 'G', 'M', 'F', 'T' };
+const std::uint32_t FRAME_TIME_INDEX_VERSION = 1;
+
+namespace data
+{
+	FrameCache::FrameCache(
+		std::string webm_path,
+		int memory_frame_count,
+		int spill)
+		:
+		_webm_path(webm_path),
+		_memory_frame_count(memory_frame_count < 0 ? MEMORY_FRAME_COUNT : memory_frame_count),
+		_spill(spill < 0 ? SPILL : spill > 0)
+	{
+		if (_spill)
+		{
+			// Determine path of spill file
+			fs::path directory = SPILL_DIRECTORY.empty() ? fs::temp_directory_path() : fs::path(SPILL_DIRECTORY);
+			_spill_path = core::misc::unique_tmp_path((directory / (
+				"frame_cache_"
+				+ std::to_string(std::hash<std::string>()(_webm_path)) + ".raw")).string()); // unique among caches and processes
+
+			// Open spill file for writing and reading
+			core::misc::create_directories(directory.string());
+			_spill_file.open(_spill_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!_spill_file.is_open())
+			{
+				core::mt::log_warn("Frame cache cannot open spill file: ", _spill_path, ". Frames will be decoded again when not in memory.");
+				_spill_path = "";
+			}
+		}
+	}
+
+	FrameCache::~FrameCache()
+	{
+		if (!_spill_path.empty())
+		{
+			_spill_file.close();
+			std::error_code ec;
+			fs::remove(_spill_path, ec);
+		}
+	}
+
+	std::shared_ptr<const simplewebm::Image> FrameCache::get(unsigned int frame_idx)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		// Look up frame in memory
+		auto memory_it = _memory.find(frame_idx);
+		if (memory_it != _memory.end())
+		{
+			return memory_it->second;
+		}
+
+		// Look up frame on disk
+		auto sp_image = restore(frame_idx);
+		if (sp_image)
+		{
+			remember(frame_idx, sp_image);
+			return sp_image;
+		}
+
+		// Frame is behind the decoder, so decode screencast again from its start
+		if (frame_idx < _decoded_count)
+		{
+			_up_video_walker = nullptr;
+			_decoded_count = 0;
+			_decoded_all = false;
+		}
+
+		// Decode frames until the requested one is available
+		if (decode_until(frame_idx))
+		{
+			return _memory.at(frame_idx);
+		}
+		return nullptr;
+	}
+
+	std::shared_ptr<const std::vector<double> > FrameCache::get_frame_times()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_sp_frame_times)
+		{
+			// Try to load times from sidecar index
+			if (FRAME_TIME_INDEX)
+			{
+				_sp_frame_times = read_frame_time_index();
+			}
+
+			// Perform a dry walk on the complete video to gather times
+			if (!_sp_frame_times)
+			{
+				auto sp_times = std::shared_ptr<std::vector<double> >(new std::vector<double>);
+				auto up_dry_video_walker = simplewebm::create_video_walker(_webm_path);
+				auto status = up_dry_video_walker->dry_walk(sp_times, 0);
+				if (status != simplewebm::Status::OK && status != simplewebm::Status::DONE)
+				{
+					core::mt::log_warn("Dry walk failed, frame times might be incomplete and are not indexed: ", _webm_path);
+				}
+				else if (FRAME_TIME_INDEX)
+				{
+					write_frame_time_index(*sp_times.get()); // only complete walks are indexed, as the index is served on later runs
+				}
+				_sp_frame_times = sp_times;
+			}
+		}
+		return _sp_frame_times;
+	}
+
+	void FrameCache::attach_walker()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		++_walker_count;
+	}
+
+	void FrameCache::detach_walker()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_walker_count > 0 && --_walker_count == 0)
+		{
+			clear_unlocked();
+		}
+	}
+
+	void FrameCache::clear()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		clear_unlocked();
+	}
+
+	void FrameCache::clear_unlocked()
+	{
+		_memory.clear();
+		_memory_order.clear();
+		_up_video_walker = nullptr;
+		_decoded_count = 0;
+		_decoded_all = false;
+	}
+
+	bool FrameCache::decode_until(unsigned int frame_idx)
+	{
+		if (!_up_video_walker && !_decoded_all)
+		{
+			_up_video_walker = simplewebm::create_video_walker(_webm_path);
+		}
+
+		// Walk frame by frame
+		auto sp_images = std::shared_ptr<std::vector<simplewebm::Image> >(new std::vector<simplewebm::Image>);
+		while (frame_idx >= _decoded_count && !_decoded_all)
+		{
+			sp_images->clear();
+			auto status = _up_video_walker->walk(sp_images, 1);
+			if (!sp_images->empty())
+			{
+				auto sp_image = std::shared_ptr<const simplewebm::Image>(new simplewebm::Image(std::move(sp_images->at(0))));
+				if (_spill_file.is_open() && _spilled.find(_decoded_count) == _spilled.end())
+				{
+					spill(_decoded_count, *sp_image.get());
+				}
+				remember(_decoded_count, sp_image);
+				++_decoded_count;
+			}
+			if (status != simplewebm::Status::OK)
+			{
+				_decoded_all = true;
+				_up_video_walker = nullptr;
+			}
+		}
+		return frame_idx < _decoded_count;
+	}
+
+	void FrameCache::remember(unsigned int frame_idx, std::shared_ptr<const simplewebm::Image> sp_image)
+	{
+		// Forget oldest frames (at least the latest frame is kept)
+		while ((int)_memory.size() >= std::max(1, _memory_frame_count) && !_memory_order.empty())
+		{
+			_memory.erase(_memory_order.front());
+			_memory_order.pop_front();
+		}
+
+		// Remember frame
+		if (_memory.emplace(frame_idx, sp_image).second)
+		{
+			_memory_order.push_back(frame_idx);
+		}
+	}
+
+	void FrameCache::spill(unsigned int frame_idx, const simplewebm::Image& r_image)
+	{
+		SpillEntry entry;
+		entry.offset = _spill_end;
+		entry.width = r_image.width;
+		entry.height = r_image.height;
+		entry.time = r_image.time;
+		entry.size = r_image.data.size();
+
+		// Append raw pixels to spill file
+		_spill_file.seekp(entry.offset);
+		_spill_file.write(r_image.data.data(), entry.size);
+		if (_spill_file.good())
+		{
+			_spill_end += (std::streamoff)entry.size;
+			_spilled[frame_idx] = entry;
+		}
+		else
+		{
+			_spill_file.clear();
+		}
+	}
+
+	std::shared_ptr<const simplewebm::Image> FrameCache::restore(unsigned int frame_idx)
+	{
+		auto spilled_it = _spilled.find(frame_idx);
+		if (spilled_it == _spilled.end())
+		{
+			return nullptr;
+		}
+
+		// Read raw pixels from spill file
+		const auto& r_entry = spilled_it->second;
+		auto sp_image = std::make_shared<simplewebm::Image>();
+		sp_image->width = r_entry.width;
+		sp_image->height = r_entry.height;
+		sp_image->time = r_entry.time;
+		sp_image->data.resize(r_entry.size);
+		_spill_file.seekg(r_entry.offset);
+		_spill_file.read(sp_image->data.data(), r_entry.size);
+		if (!_spill_file.good())
+		{
+			_spill_file.clear();
+			_spilled.erase(spilled_it);
+			return nullptr;
+		}
+		return sp_image;
+	}
+
+	std::shared_ptr<const std::vector<double> > FrameCache::read_frame_time_index() const
+	{
+		std::ifstream in(_webm_path + FRAME_TIME_INDEX_SUFFIX, std::ios::binary);
+		if (!in.is_open()) { return nullptr; }
+
+		// Compare header with screencast
+		std::uint64_t size = 0; std::int64_t mtime = 0;
+		if (!core::misc::stamp_file(_webm_path, size, mtime)) { return nullptr; }
+		char magic[4];
+		std::uint32_t version = 0;
+		std::uint64_t index_size = 0, count = 0;
+		std::int64_t index_mtime = 0;
+		in.read(magic, sizeof(magic));
+		in.read(reinterpret_cast<char*>(&version), sizeof(version));
+		in.read(reinterpret_cast<char*>(&index_size), sizeof(index_size));
+		in.read(reinterpret_cast<char*>(&index_mtime), sizeof(index_mtime));
+		in.read(reinterpret_cast<char*>(&count), sizeof(count));
+		if (!in.good()
+			|| std::memcmp(magic, FRAME_TIME_INDEX_MAGIC, sizeof(magic)) != 0
+			|| version != FRAME_TIME_INDEX_VERSION
+			|| index_size != size
+			|| index_mtime != mtime)
+		{
+			return nullptr;
+		}
+
+		// Check count against remaining size of index, so a corrupt index cannot request a huge allocation
+		const std::streamoff header_size = in.tellg();
+		std::error_code ec;
+		const std::uint64_t file_size = (std::uint64_t)fs::file_size(_webm_path + FRAME_TIME_INDEX_SUFFIX, ec);
+		if (ec || header_size < 0 || file_size < (std::uint64_t)header_size || count > (file_size - (std::uint64_t)header_size) / sizeof(double))
+		{
+			return nullptr;
+		}
+
+		// Read times
+		auto sp_times = std::shared_ptr<std::vector<double> >(new std::vector<double>(count));
+		in.read(reinterpret_cast<char*>(sp_times->data()), count * sizeof(double));
+		if (!in.good()) { return nullptr; }
+		return sp_times;
+	}
+
+	void FrameCache::write_frame_time_index(const std::vector<double>& r_times) const
+	{
+		std::uint64_t size = 0; std::int64_t mtime = 0;
+		if (!core::misc::stamp_file(_webm_path, size, mtime)) { return; }
+
+		// Write into temporary file first, so concurrent runs never read a partial index
+		const std::string index_path = _webm_path + FRAME_TIME_INDEX_SUFFIX;
+		const std::string tmp_path = core::misc::unique_tmp_path(index_path);
+		bool written = false;
+		{
+			std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+			if (!out.is_open())
+			{
+				core::mt::log_warn("Frame time index cannot be written: ", index_path);
+				return;
+			}
+			std::uint64_t count = r_times.size();
+			out.write(FRAME_TIME_INDEX_MAGIC, sizeof(FRAME_TIME_INDEX_MAGIC));
+			out.write(reinterpret_cast<const char*>(&FRAME_TIME_INDEX_VERSION), sizeof(FRAME_TIME_INDEX_VERSION));
+			out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+			out.write(reinterpret_cast<const char*>(&mtime), sizeof(mtime));
+			out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+			out.write(reinterpret_cast<const char*>(r_times.data()), count * sizeof(double));
+			written = out.good();
+		}
+		std::error_code ec;
+		if (written)
+		{
+			fs::rename(tmp_path, index_path, ec);
+		}
+		if (!written || ec)
+		{
+			fs::remove(tmp_path, ec);
+		}
+	}
+}
@@ -0,0 +1,118 @@
+//! Frame cache.
+/*!
+Per-session store of decoded screencast frames, serving the frames to all stages and walkers.
+Keeps a bounded amount of frames in memory while walkers are attached, so walkers over the same frames at the same time
+share the decoding. Stages that walk one after another only share the decoding if spilling to disk is enabled (opt-in,
+as it requires width * height * 3 bytes per frame). Otherwise each stage decodes the screencast once more, and a jump
+backwards behind the frames in memory decodes from the start of the screencast, as it has no keyframe index.
+Times of the frames are stored in a sidecar index next to the screencast, so later runs do not need a dry walk.
+*/
+
+#pragma once
+
+#include <libsimplewebm.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <fstream>
+
+namespace data
+{
+	class FrameCache
+	{
+	public:
+
+		// Constructor. Nothing is decoded before the first frame is requested.
+		// Negative memory frame count or spill value falls back to the config
+		FrameCache(
+			std::string webm_path, // path to screencast
+			int memory_frame_count = -1, // count of decoded frames kept in memory
+			int spill = -1); // whether decoded frames are spilled to disk (0 or 1)
+
+		// Destructor, removes spill file
+		~FrameCache();
+
+		// Get decoded frame by index. Returns nullptr if the screencast has no such frame. Thread-safe
+		std::shared_ptr<const simplewebm::Image> get(unsigned int frame_idx);
+
+		// Get times of all frames in screencast. Loaded from the sidecar index if it matches the screencast,
+		// otherwise gathered by a dry walk and written to the sidecar index. Thread-safe
+		std::shared_ptr<const std::vector<double> > get_frame_times();
+
+		// Get path to screencast
+		std::string get_webm_path() const { return _webm_path; }
+
+		// Attach and detach a walker over the frames. When the last walker detaches, frames in memory and the decoder are
+		// released, as the next stage walks from the start. Spilled frames and frame times are kept. Thread-safe
+		void attach_walker();
+		void detach_walker();
+
+		// Release frames in memory and the decoder. Frames are decoded again or restored from disk when requested. Thread-safe
+		void clear();
+
+	private:
+
+		// Remove copy and assignment operators
+		FrameCache(const FrameCache&) = delete;
+		FrameCache& operator=(const FrameCache&) = delete;
+
+		// Release frames in memory and the decoder, caller must hold the mutex
+		void clear_unlocked();
+
+		// Decode frames until frame_idx is decoded. Returns false if screencast ended before
+		bool decode_until(unsigned int frame_idx);
+
+		// Keep frame in memory, forgets oldest frames when bound is reached
+		void remember(unsigned int frame_idx, std::shared_ptr<const simplewebm::Image> sp_image);
+
+		// Write frame to spill file
+		void spill(unsigned int frame_idx, const simplewebm::Image& r_image);
+
+		// Read frame from spill file. Returns nullptr if frame has not been spilled
+		std::shared_ptr<const simplewebm::Image> restore(unsigned int frame_idx);
+
+		// Read frame times from sidecar index. Returns nullptr if index is missing or outdated
+		std::shared_ptr<const std::vector<double> > read_frame_time_index() const;
+
+		// Write frame times to sidecar index
+		void write_frame_time_index(const std::vector<double>& r_times) const;
+
+		// Location of a spilled frame
+		struct SpillEntry
+		{
+			std::streamoff offset = 0;
+			int width = 0;
+			int height = 0;
+			double time = 0.0;
+			std::size_t size = 0;
+		};
+
+		// Members
+		const std::string _webm_path;
+		const int _memory_frame_count;
+		const bool _spill;
+		std::mutex _mutex;
+		unsigned int _walker_count = 0; // attached walkers
+
+		// Decoding
+		std::unique_ptr<simplewebm::VideoWalker> _up_video_walker = nullptr;
+		unsigned int _decoded_count = 0; // frames decoded by current video walker
+		bool _decoded_all = false; // current video walker has reached end of screencast
+
+		// Frames in memory
+		std::map<unsigned int, std::shared_ptr<const simplewebm::Image> > _memory;
+		std::deque<unsigned int> _memory_order; // order of insertion, front is oldest
+
+		// Frame times
+		std::shared_ptr<const std::vector<double> > _sp_frame_times = nullptr;
+
+		// Frames on disk
+		std::string _spill_path = "";
+		std::fstream _spill_file;
+		std::streamoff _spill_end = 0;
+		std::map<unsigned int, SpillEntry> _spilled;
+	};
+}
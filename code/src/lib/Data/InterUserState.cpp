@@ -209,7 +209,7 @@ namespace data
 		auto wp_intra_container = sp_first_intra->get_container();
 		if (auto sp_intra_container = wp_intra_container.lock())
 		{
-			std::string xpath = sp_intra_container->get_log_datum_container()->get()->at(frame_idx_start)->access_layer(layer_acess)->get_xpath();
+			std::string xpath = sp_intra_container->get_log_datum_container()->get_layer_arena()->access_layer(frame_idx_start, layer_acess)->get_xpath();
 			std::replace(xpath.begin(), xpath.end(), '/', '~'); // replace slash with something else. Otherwise, subfolders are created
 			id = id + "_" + xpath; // append id of inter-user state container with xpath
 		}
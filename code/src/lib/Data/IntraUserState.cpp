@@ -2,6 +2,7 @@
 #include <fstream>
 #include <iomanip>
 #include <ctime>
+#include <algorithm>
 
 const int PIXEL_HISTORY_DEPTH = core::mt::get_config_value(5, { "splitting", "splitter", "pixel_history_depth" });
 
@@ -15,7 +16,7 @@ namespace data
 		int x_offset,
 		int y_offset)
 		:
-		State(cv::Mat(1, 1, CV_8UC4)), // start with empty stitched screenshot (must be at least 1x1, why?)
+		State(cv::Mat::zeros(1, 1, CV_8UC4)), // start with empty stitched screenshot (must be at least 1x1, why?)
 		_wp_container(wp_container),
 		_frame_idx_start(frame_idx_start),
 		_frame_idx_end(frame_idx_start),
@@ -35,7 +36,7 @@ namespace data
 			{
 				// Get all the input of that layer
 				auto layer_access = this->get_layer_access(i); // get path to layer in that log datum
-				auto sp_layer = sp_container->get_log_datum_container()->get()->at(i)->access_layer(layer_access); // access log datum with that path to retrieve layer
+				auto sp_layer = sp_container->get_log_datum_container()->get_layer_arena()->access_layer(i, layer_access); // access log datum with that path to retrieve layer
 				auto input = sp_layer->get_input(); // retrieve original input
 
 				// Get scrolling to transform from view to document space
@@ -181,123 +182,148 @@ namespace data
 
 	void IntraUserState::store_and_stich(const cv::Mat& input_pixels, int x_offset, int y_offset)
 	{
-		// Store input pixels as compressed PNG
-		_pixel_history.push_back(
-			std::tuple<std::shared_ptr<std::vector<uchar> >, int, int> // compressed pixels, x-offset, y-offset
-			(std::make_shared<std::vector<uchar> >(), x_offset, y_offset));
-		cv::imencode(".png", input_pixels, *(std::get<0>(_pixel_history.back()).get()));
-
-		// Limit depth of the history
-		int depth_diff = (int)_pixel_history.size() - PIXEL_HISTORY_DEPTH;
-		for (int i = 0; i < depth_diff; ++i)
+		// Remember offsets of latest frame, its row hashes are provided by the caller
+		_latest_row_hashes.clear();
+		_latest_x_offset = x_offset;
+		_latest_y_offset = y_offset;
+
+		// Crop input pixels to rows and columns with non-transparent pixels, other pixels are not voted for
+		HistoryFrame frame;
+		frame.x_offset = x_offset;
+		frame.y_offset = y_offset;
+		if (!input_pixels.empty())
 		{
-			_pixel_history.pop_front();
+			cv::Mat alpha, alpha_rows, alpha_cols;
+			cv::extractChannel(input_pixels, alpha, 3);
+			cv::reduce(alpha, alpha_rows, 1, cv::REDUCE_MAX); // one column
+			cv::reduce(alpha, alpha_cols, 0, cv::REDUCE_MAX); // one row
+			int y_begin = 0, y_end = alpha_rows.rows, x_begin = 0, x_end = alpha_cols.cols;
+			while (y_begin < y_end && alpha_rows.at<uchar>(y_begin, 0) == 0) { ++y_begin; }
+			while (y_end > y_begin && alpha_rows.at<uchar>(y_end - 1, 0) == 0) { --y_end; }
+			while (x_begin < x_end && alpha_cols.at<uchar>(0, x_begin) == 0) { ++x_begin; }
+			while (x_end > x_begin && alpha_cols.at<uchar>(0, x_end - 1) == 0) { --x_end; }
+			if (y_begin < y_end && x_begin < x_end)
+			{
+				frame.pixels = input_pixels(cv::Rect(x_begin, y_begin, x_end - x_begin, y_end - y_begin)).clone(); // raw copy
+				frame.x_offset += x_begin;
+				frame.y_offset += y_begin;
+			}
 		}
 
-		// Make current stitched screenshot large enough to contain new pixels
+		// Store frame in ring buffer of pixel history, overwriting the oldest frame when full
+		const unsigned int depth = (unsigned int)std::max(1, PIXEL_HISTORY_DEPTH);
+		if (_pixel_history.size() < depth)
+		{
+			_pixel_history.push_back(frame);
+		}
+		else
+		{
+			_pixel_history.at(_pixel_history_next) = frame;
+			_pixel_history_next = (_pixel_history_next + 1) % depth;
+		}
+
+		// Rect of input pixels in stitched screenshot
 		cv::Rect input_pixels_rect(x_offset, y_offset, input_pixels.cols, input_pixels.rows); // global coordinates
-		cv::Mat stitched_screenshot_clone = get_stitched_screenshot().clone(); // clone of current stitched screenshot
-		core::opencv::extend(stitched_screenshot_clone, input_pixels_rect); // extend stitched screenshot
 
-		// Stitch stored pixels onto cloned stitched screenshot (but only within the extends of the input pixels, other pixels stay untouched)
+		// Stitch stored pixels onto stitched screenshot (but only within the extends of the input pixels, other pixels stay untouched)
 		struct StitchPixels
 		{
-			cv::Mat ROI; // region of interest in stored matrix
-			int x_rel_offset; // offset between input pixels and ROI in stored matrix
-			int y_rel_offset; // offset between input pixels and ROI in stored matrix
+			const HistoryFrame* p_frame;
+			cv::Rect rect; // intersection of input pixels and stored frame, relative to input pixels
 		};
 		std::vector<StitchPixels> stitch_pixels;
-		for (const auto& stored : _pixel_history)
+		for (const auto& r_stored : _pixel_history)
 		{
 			// Get intersection between pixels input rect and stored one in global space
-			cv::Mat stored_mat = cv::imdecode(*(std::get<0>(stored)).get(), -1); // -1 ensures decoding with alpha channel
-			int x_stored = std::get<1>(stored);
-			int y_stored = std::get<2>(stored);
-			cv::Rect intersect = input_pixels_rect & cv::Rect(x_stored, y_stored, stored_mat.cols, stored_mat.rows);
+			if (r_stored.pixels.empty()) { continue; }
+			cv::Rect intersect = input_pixels_rect & cv::Rect(r_stored.x_offset, r_stored.y_offset, r_stored.pixels.cols, r_stored.pixels.rows);
 
 			// If no intersection between input and stored, does not matter for stitching
 			if (intersect.empty()) { continue; }
 
-			// Bring from global space into local space of stored matrix
-			intersect.x -= x_stored;
-			intersect.y -= y_stored;
-
-			// Create struct
-			StitchPixels tmp;
-			tmp.ROI = stored_mat(intersect);
-			tmp.x_rel_offset = x_offset - x_stored - intersect.x; // access offset for later iteration
-			tmp.y_rel_offset = y_offset - y_stored - intersect.y; // access offset for later iteration
-			stitch_pixels.push_back(tmp);
+			// Bring from global space into local space of input pixels
+			intersect.x -= x_offset;
+			intersect.y -= y_offset;
+			stitch_pixels.push_back({ &r_stored, intersect });
 		}
 
-		// Go over stored pixels and compose the stitched screenshot
-		for (int x = 0; x < input_pixels.cols; ++x)
+		// Go over input pixels row by row and compose the stitched screenshot by majority vote of the stored pixels
+		cv::Mat target = cv::Mat::zeros(input_pixels.rows, input_pixels.cols, CV_8UC4); // voted pixels
+		cv::Mat target_mask = cv::Mat::zeros(input_pixels.rows, input_pixels.cols, CV_8UC1); // pixels with at least one vote
+		std::vector<const cv::Vec4b*> rows(stitch_pixels.size(), nullptr); // row of each stored frame
+		std::vector<int> shifts(stitch_pixels.size(), 0); // x-coordinate of first pixel of each stored frame in input pixels space
+		for (int i = 0; i < (int)stitch_pixels.size(); ++i)
+		{
+			shifts.at(i) = stitch_pixels.at(i).p_frame->x_offset - x_offset;
+		}
+		std::vector<int> colors(stitch_pixels.size(), 0); // votes of one pixel, RGB as single integer
+		for (int y = 0; y < input_pixels.rows; ++y)
 		{
-			for (int y = 0; y < input_pixels.rows; ++y)
+			// Rows of stored frames that cover this row
+			for (int i = 0; i < (int)stitch_pixels.size(); ++i)
 			{
-				// Compute most prominent value
-				std::map<int, int > rgb_freq; // RGB + count
-				uchar a = 0;
-
-				// Go over available screenshots to take pixels from
-				for (const auto& stich_pixel : stitch_pixels)
+				const auto& r_stitch_pixel = stitch_pixels.at(i);
+				const auto& r_rect = r_stitch_pixel.rect;
+				rows.at(i) = nullptr;
+				if (y >= r_rect.y && y < r_rect.y + r_rect.height)
 				{
-					// Compute relative x and y for the ROI
-					int rel_x = x + stich_pixel.x_rel_offset;
-					int rel_y = y + stich_pixel.y_rel_offset;
-
-					// Check whether coordinates are still within range (should not happen)
-					cv::Rect rect(0, 0, stich_pixel.ROI.cols, stich_pixel.ROI.rows);
-					if (!rect.contains(cv::Point(rel_x, rel_y)))
-					{
-						continue;
-					}
+					const auto* p_frame = r_stitch_pixel.p_frame;
+					rows.at(i) = p_frame->pixels.ptr<cv::Vec4b>(y + y_offset - p_frame->y_offset); // indexed by x minus shift
+				}
+			}
 
-					// Store pixel values
-					const auto& v = stich_pixel.ROI.at<const cv::Vec4b>(rel_y, rel_x);
+			cv::Vec4b* p_target = target.ptr<cv::Vec4b>(y);
+			uchar* p_target_mask = target_mask.ptr<uchar>(y);
+			for (int x = 0; x < input_pixels.cols; ++x)
+			{
+				// Collect votes of stored frames
+				int vote_count = 0;
+				uchar a = 0;
+				for (int i = 0; i < (int)stitch_pixels.size(); ++i)
+				{
+					const auto& r_rect = stitch_pixels.at(i).rect;
+					if (!rows.at(i) || x < r_rect.x || x >= r_rect.x + r_rect.width) { continue; }
+					const auto& v = rows.at(i)[x - shifts.at(i)];
 					if (v[3] <= 0) { continue; } // skip totally transparent pixels
 
 					// Convert RGB to single integer
-					int rgb = (int)v[2];
-					rgb = (rgb << 8) + (int)v[1];
-					rgb = (rgb << 8) + (int)v[0];
-					
-					// Enter found value to map
-					auto it = rgb_freq.find(rgb);
-					if (it != rgb_freq.end()) { (it->second)++; }
-					else { rgb_freq[rgb] = 1; }
+					colors.at(vote_count++) = ((int)v[2] << 16) | ((int)v[1] << 8) | (int)v[0];
 
 					// Alpha channel (take maximum found)
 					a = a < v[3] ? v[3] : a;
 				}
+				if (vote_count <= 0) { continue; }
 
+				// Get most common color, ties are decided for smaller RGB value
 				// TODO one could further improve: if there is an even count for two colors, compute mean etc.
-				if (!rgb_freq.empty())
+				int most_rgb = colors.at(0);
+				int most_rgb_cnt = 0;
+				for (int i = 0; i < vote_count; ++i)
 				{
-					// Get most common color
-					int most_rgb = 0;
-					int most_rgb_cnt = 0;
-					for (const auto& r_entry : rgb_freq)
+					int cnt = 0;
+					for (int j = 0; j < vote_count; ++j)
 					{
-						if (r_entry.second > most_rgb_cnt)
-						{
-							most_rgb = r_entry.first;
-							most_rgb_cnt = r_entry.second;
-						}
+						cnt += colors[j] == colors[i] ? 1 : 0;
+					}
+					if (cnt > most_rgb_cnt || (cnt == most_rgb_cnt && colors[i] < most_rgb))
+					{
+						most_rgb = colors[i];
+						most_rgb_cnt = cnt;
 					}
-
-					// Below is important to use a reference to the pixel value!
-					auto& v = stitched_screenshot_clone(input_pixels_rect).at<cv::Vec4b>(y, x);
-					v[0] = most_rgb & 0xFF;
-					v[1] = (most_rgb >> 8) & 0xFF;
-					v[2] = (most_rgb >> 16) & 0xFF;
-					v[3] = a;
 				}
+
+				// Set pixel value
+				auto& v = p_target[x];
+				v[0] = most_rgb & 0xFF;
+				v[1] = (most_rgb >> 8) & 0xFF;
+				v[2] = (most_rgb >> 16) & 0xFF;
+				v[3] = a;
+				p_target_mask[x] = 255;
 			}
 		}
 
-		// Set new stitched screenshot
-		set_stitched_screenshot(stitched_screenshot_clone);
+		// Write voted pixels into stitched screenshot, which grows to contain the input pixels
+		write_stitched_screenshot(input_pixels_rect, target, target_mask);
 	}
 
 	unsigned int IntraUserState::get_idx_in_container() const
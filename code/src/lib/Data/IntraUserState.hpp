@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 #include <deque>
+#include <utility>
 
 // TODO: decide how to decide on general "layer" of intra-user state. must be available to cluster into intra-user states later
 // Note: captures enclosed part in time with begin and end
@@ -59,6 +60,14 @@ namespace data
 		unsigned int get_frame_count() const { return ((int)_frame_idx_end - (int)_frame_idx_start) + 1;}
 		std::weak_ptr<const IntraUserStateContainer> get_container() const { return _wp_container; }
 
+		// Row hashes of the pixels of the latest frame, to detect unchanged rows in the next frame. Cleared when a frame is added
+		void set_latest_row_hashes(std::vector<std::uint64_t> row_hashes) { _latest_row_hashes = std::move(row_hashes); }
+		const std::vector<std::uint64_t>& get_latest_row_hashes() const { return _latest_row_hashes; }
+
+		// Offsets of the pixels of the latest frame
+		int get_latest_x_offset() const { return _latest_x_offset; }
+		int get_latest_y_offset() const { return _latest_y_offset; }
+
 		// Get index of intra-user state in its container
 		unsigned int get_idx_in_container() const;
 		
@@ -70,6 +79,14 @@ namespace data
 		
 	private:
 
+		// Frame of pixel history, cropped to its non-transparent pixels
+		struct HistoryFrame
+		{
+			cv::Mat pixels; // BGRA
+			int x_offset; // x-offset of cropped pixels
+			int y_offset; // y-offset of cropped pixels
+		};
+
 		// Store and stitch screenshot from pixels
 		void store_and_stich(const cv::Mat& pixels, int x_offset, int y_offset);
 
@@ -78,7 +95,11 @@ namespace data
 		unsigned int _frame_idx_start; // start index in screencast (including)
 		unsigned int _frame_idx_end; // end index in screencast (including)
 		std::deque<std::vector<unsigned int> > _layer_accesses; // for each frame_idx (_frame_idx_end-_frame_idx_start+1 many), store which layer from the log dates is captured here
-		std::deque<std::tuple<std::shared_ptr<std::vector<uchar> >, int, int> > _pixel_history; // compressed pixels, x-offset and y-offset
+		std::vector<HistoryFrame> _pixel_history; // ring buffer of the latest frames
+		unsigned int _pixel_history_next = 0; // index in ring buffer to be overwritten next, once it is full
+		std::vector<std::uint64_t> _latest_row_hashes; // of pixels of latest frame, empty if unknown
+		int _latest_x_offset = 0;
+		int _latest_y_offset = 0;
 		std::vector<unsigned int> _blind_frame_idxs; // idxs of frames that are not contributing to the screenshot
 		// TODO: store viewport position for each frame
 	};
@@ -1,6 +1,10 @@
 #include "Layer.hpp"
 #include <Core/Core.hpp>
 #include <opencv2/opencv.hpp>
+#include <unordered_map>
+#include <deque>
+#include <mutex>
+#include <atomic>
 
 namespace data
 {
@@ -18,6 +22,39 @@ namespace data
 		}
 	}
 
+	// Global symbol table of xpaths
+	struct XPathTable
+	{
+		XPathTable() { ids.emplace("", 0); xpaths.push_back(""); } // empty xpath has id zero
+		std::mutex mutex;
+		std::unordered_map<std::string, XPathId> ids;
+		std::deque<std::string> xpaths; // references stay valid when appending
+	};
+	static XPathTable& get_xpath_table()
+	{
+		static XPathTable table;
+		return table;
+	}
+
+	XPathId intern_xpath(const std::string& r_xpath)
+	{
+		auto& r_table = get_xpath_table();
+		std::lock_guard<std::mutex> lock(r_table.mutex);
+		auto result = r_table.ids.emplace(r_xpath, (XPathId)r_table.xpaths.size());
+		if (result.second) // xpath is new
+		{
+			r_table.xpaths.push_back(r_xpath);
+		}
+		return result.first->second;
+	}
+
+	const std::string& get_interned_xpath(XPathId id)
+	{
+		auto& r_table = get_xpath_table();
+		std::lock_guard<std::mutex> lock(r_table.mutex);
+		return r_table.xpaths.at(id);
+	}
+
 	Input::~Input()
 	{
 		// Nothing to do
@@ -28,12 +65,42 @@ namespace data
 		// Nothing to do
 	}
 
+	// Mask of layer cropped to the rect covering its white pixels
+	struct Layer::CompactViewMask
+	{
+		int width = 0; // width of viewport
+		int height = 0; // height of viewport
+		cv::Rect rect = cv::Rect(0, 0, 0, 0); // covering rect in viewport space
+		cv::Mat pixels; // pixels within rect, empty if all pixels within rect are white
+	};
+
+	Layer::Layer(const Layer& r_other) :
+		std::enable_shared_from_this<Layer>(),
+		_type(r_other._type),
+		_xpath_id(r_other._xpath_id),
+		_view_pos(r_other._view_pos),
+		_view_width(r_other._view_width),
+		_view_height(r_other._view_height),
+		_scroll_x(r_other._scroll_x),
+		_scroll_y(r_other._scroll_y),
+		_zindex(r_other._zindex),
+		_is_child(r_other._is_child),
+		_root_view_width(r_other._root_view_width),
+		_root_view_height(r_other._root_view_height),
+		_children(r_other._children),
+		_sp_view_mask(std::atomic_load(&r_other._sp_view_mask)), // other might be read by other threads
+		_input(r_other._input)
+	{}
+
 	void Layer::append_child(std::shared_ptr<Layer> sp_layer)
 	{
-		assert(("Layer::append_child: Layer has already a parent",
-				sp_layer->_wp_parent.expired()));
-		
-		sp_layer->_wp_parent = this->shared_from_this(); // tell layer who is its parent
+		invalidate_view_mask();
+
+		int root_view_width = 0, root_view_height = 0;
+		get_view_size_of_root(root_view_width, root_view_height);
+
+		sp_layer->_is_child = true; // tell layer that it has a parent
+		sp_layer->set_root_view_size(root_view_width, root_view_height);
 		_children.push_back(sp_layer); // add layer to children
 	}
 
@@ -62,56 +129,75 @@ namespace data
 	{
 		std::vector<std::shared_ptr<Layer> > output;
 		output.reserve((int)_children.size());
-		for (auto& rsp_child : _children)
+		for (unsigned int idx = 0; idx < (unsigned int)_children.size(); ++idx)
 		{
-			output.push_back(rsp_child);
+			output.push_back(mutable_child(idx));
 		}
 		return output;
 	}
 
 	std::shared_ptr<const Layer> Layer::access(const std::vector<unsigned int>& r_access, unsigned int access_idx) const
 	{
-		if (access_idx >= r_access.size())
+		// Navigate without touching reference counts, only the accessed layer is shared
+		const Layer* p_layer = this;
+		for (; access_idx < r_access.size(); ++access_idx)
 		{
-			return this->shared_from_this();
-		}
-		else
-		{
-			auto sp_child = _children.at(r_access.at(access_idx));
-			return sp_child->access(r_access, ++access_idx);
+			p_layer = p_layer->_children.at(r_access.at(access_idx)).get();
 		}
+		return p_layer->shared_from_this();
 	}
 
 	std::shared_ptr<Layer> Layer::access(const std::vector<unsigned int>& r_access, unsigned int access_idx)
 	{
-		if (access_idx >= r_access.size())
+		// Navigate iteratively, copying shared layers on the path
+		std::shared_ptr<Layer> sp_layer = this->shared_from_this();
+		for (; access_idx < r_access.size(); ++access_idx)
 		{
-			return this->shared_from_this();
-		}
-		else
-		{
-			auto sp_child = _children.at(r_access.at(access_idx));
-			return sp_child->access(r_access, ++access_idx);
+			sp_layer = sp_layer->mutable_child(r_access.at(access_idx));
 		}
+		return sp_layer;
 	}
 
 	cv::Mat Layer::get_view_mask() const
 	{
-		// Get own mask
-		cv::Mat mask = get_simple_view_mask();
-
-		// Get masks of children
-		cv::Mat children_mask = get_children_view_mask();
-		if (!children_mask.size().empty())
+		// Rasterize compact mask
+		auto sp_compact = get_compact_view_mask();
+		cv::Mat mask = cv::Mat::zeros(sp_compact->height, sp_compact->width, CV_8UC1); // as big as viewport
+		if (sp_compact->rect.area() > 0)
 		{
-			// Subtract children from own mask			
-			cv::absdiff(mask, children_mask, mask);
+			if (sp_compact->pixels.empty())
+			{
+				mask(sp_compact->rect) = cv::Scalar(255);
+			}
+			else
+			{
+				sp_compact->pixels.copyTo(mask(sp_compact->rect));
+			}
 		}
 
 		// Return mask
 		return mask;
 	}
 
+	cv::Rect Layer::get_view_mask_rect() const
+	{
+		return get_compact_view_mask()->rect;
+	}
+
+	bool Layer::is_in_view_mask(int view_x, int view_y) const
+	{
+		// Masks are as big as viewport
+		int width, height = 0;
+		get_view_size_of_root(width, height);
+		if (view_x < 0 || view_y < 0 || view_x >= width || view_y >= height)
+		{
+			return false;
+		}
+
+		// Children are subtracted from own mask by absolute difference
+		return is_in_simple_view_mask(view_x, view_y) != is_in_children_view_mask(view_x, view_y);
+	}
+
 	void Layer::push_back_input(std::shared_ptr<const Input> sp_input)
 	{
 		_input.push_back(sp_input);
@@ -130,7 +216,7 @@ namespace data
 
 		// Add fields of layer
 		sp_datum->add(vd_strings("Type")->add(to_string(_type)));
-		sp_datum->add(vd_strings("xpath")->add(_xpath));
+		sp_datum->add(vd_strings("xpath")->add(get_xpath()));
 		sp_datum->add(vd_strings("view_pos_x")->add(std::to_string(_view_pos.x)));
 		sp_datum->add(vd_strings("view_pos_y")->add((std::to_string(_view_pos.y))));
 		sp_datum->add(vd_strings("view_width")->add((std::to_string(_view_width))));
@@ -155,10 +241,11 @@ namespace data
 
 	void Layer::get_view_size_of_root(int& r_view_width, int& r_view_height) const
 	{
-		if (auto sp_parent = _wp_parent.lock())
+		if (_is_child)
 		{
-			// There is another level in the layer tree, delegate the task upwards
-			sp_parent->get_view_size_of_root(r_view_width, r_view_height);
+			// There is another level in the layer tree, take the size of its root
+			r_view_width = _root_view_width;
+			r_view_height = _root_view_height;
 		}
 		else // I AM ROOT
 		{
@@ -167,6 +254,60 @@ namespace data
 		}
 	}
 
+	void Layer::update_root_view_size()
+	{
+		if (!_is_child)
+		{
+			for (unsigned int idx = 0; idx < (unsigned int)_children.size(); ++idx)
+			{
+				const auto& rsp_child = _children.at(idx);
+				if (rsp_child->_root_view_width != _view_width || rsp_child->_root_view_height != _view_height)
+				{
+					mutable_child(idx)->set_root_view_size(_view_width, _view_height);
+				}
+			}
+		}
+	}
+
+	void Layer::set_root_view_size(int root_view_width, int root_view_height)
+	{
+		invalidate_view_mask();
+		_root_view_width = root_view_width;
+		_root_view_height = root_view_height;
+		for (unsigned int idx = 0; idx < (unsigned int)_children.size(); ++idx)
+		{
+			const auto& rsp_child = _children.at(idx);
+			if (rsp_child->_root_view_width != root_view_width || rsp_child->_root_view_height != root_view_height)
+			{
+				mutable_child(idx)->set_root_view_size(root_view_width, root_view_height);
+			}
+		}
+	}
+
+	std::shared_ptr<Layer>& Layer::mutable_child(unsigned int idx)
+	{
+		auto& rsp_child = _children.at(idx);
+		invalidate_view_mask();
+		if (rsp_child->_owner != _owner) // child might be shared with other layer trees
+		{
+			rsp_child = rsp_child->copy_for(_owner);
+		}
+		return rsp_child;
+	}
+
+	std::shared_ptr<Layer> Layer::copy_for(std::uint64_t owner) const
+	{
+		auto sp_copy = std::shared_ptr<Layer>(new Layer(*this));
+		sp_copy->_owner = owner;
+		return sp_copy;
+	}
+
+	std::uint64_t Layer::create_owner()
+	{
+		static std::atomic<std::uint64_t> owner_counter(0);
+		return ++owner_counter; // zero is no owner
+	}
+
 	cv::Mat Layer::get_simple_view_mask() const
 	{
 		// Estimate size of viewport
@@ -210,4 +351,76 @@ namespace data
 
 		return acc_mask;
 	}
+
+	bool Layer::is_in_simple_view_mask(int view_x, int view_y) const
+	{
+		cv::Rect layer_rect(_view_pos.x, _view_pos.y, _view_width, _view_height);
+		return layer_rect.contains(cv::Point2i(view_x, view_y));
+	}
+
+	bool Layer::is_in_children_view_mask(int view_x, int view_y) const
+	{
+		for (const auto& sp_child : _children)
+		{
+			if (sp_child->is_in_simple_view_mask(view_x, view_y) || sp_child->is_in_children_view_mask(view_x, view_y))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::shared_ptr<const Layer::CompactViewMask> Layer::get_compact_view_mask() const
+	{
+		auto sp_compact = std::atomic_load(&_sp_view_mask);
+		if (sp_compact)
+		{
+			return sp_compact;
+		}
+
+		// Estimate size of viewport
+		auto sp_new = std::make_shared<CompactViewMask>();
+		get_view_size_of_root(sp_new->width, sp_new->height);
+		cv::Rect layer_rect(_view_pos.x, _view_pos.y, _view_width, _view_height);
+		cv::Rect viewport_rect(0, 0, sp_new->width, sp_new->height);
+
+		if (_children.empty())
+		{
+			// Mask is the layer rect within the viewport
+			sp_new->rect = viewport_rect & layer_rect;
+		}
+		else
+		{
+			// Get own mask and subtract children from it
+			cv::Mat mask = get_simple_view_mask();
+			cv::Mat children_mask = get_children_view_mask();
+			if (!children_mask.size().empty())
+			{
+				cv::absdiff(mask, children_mask, mask);
+			}
+
+			// Crop mask to its white pixels
+			if (cv::countNonZero(mask) > 0)
+			{
+				std::vector<cv::Point> points;
+				cv::findNonZero(mask, points);
+				sp_new->rect = cv::boundingRect(points);
+				sp_new->pixels = mask(sp_new->rect).clone();
+			}
+		}
+		if (sp_new->rect.area() <= 0)
+		{
+			sp_new->rect = cv::Rect(0, 0, 0, 0);
+		}
+
+		// Cache compact mask (concurrent callers might compute the same mask, last one is kept)
+		sp_compact = sp_new;
+		std::atomic_store(&_sp_view_mask, sp_compact);
+		return sp_compact;
+	}
+
+	void Layer::invalidate_view_mask()
+	{
+		std::atomic_store(&_sp_view_mask, std::shared_ptr<const CompactViewMask>());
+	}
 }
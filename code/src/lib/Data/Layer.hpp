@@ -7,6 +7,7 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <cstdint>
 
 // TODO: make serializable (together with log datum)
 // TODO: catch node by type + xpath? to check whether node already exists?
@@ -75,16 +76,28 @@ namespace data
 
 	// Convert layer type to std::string
 	std::string to_string(LayerType type);
+
+	// Id of an interned xpath. Equal xpaths have equal ids, id of the empty xpath is zero
+	typedef unsigned int XPathId;
+
+	// Intern xpath into global symbol table and get its id. Thread-safe
+	XPathId intern_xpath(const std::string& r_xpath);
+
+	// Get xpath of interned id. Thread-safe
+	const std::string& get_interned_xpath(XPathId id);
 	
 	// Forward declaration
 	class LogDatum;
 
-	// Layer class
+	// Layer class. Layers are shared copy-on-write among the layer trees of log dates,
+	// non-const access to a layer tree copies the shared layers on the path to the accessed layer.
+	// A layer is modified in place only by the tree that owns it, i.e., that has copied it. Other references
+	// to a layer, e.g., by layer packs, do not cause copies. A layer of a log datum must not be appended to another layer
 	class Layer : public std::enable_shared_from_this<Layer>
 	{
 	public:
 
-		// Required for deep copy of layer
+		// Required for copy-on-write of root layer
 		friend class LogDatum;
 
 		// Force the use of shared pointer
@@ -93,7 +106,8 @@ namespace data
 			return std::shared_ptr<Layer>(new Layer());
 		}
 
-		// Append child. This layer is set as parent
+		// Append child. Child takes over the view size of the root of this layer.
+		// A child may be appended to multiple layers, which then must share the view size of their root
 		void append_child(std::shared_ptr<Layer> sp_layer);
 
 		// Access child by index within children vector
@@ -102,20 +116,29 @@ namespace data
 		// Get count of children (for iteration)
 		unsigned int get_child_count() const;
 
-		// Get vector of all children
+		// Get vector of all children. Non-const version copies shared children
 		std::vector<std::shared_ptr<const Layer> > get_children() const;
 		std::vector<std::shared_ptr<Layer> > get_children();
 
-		// Access layer or its child. Access describes indices of layers in structure and access_idx the index within that indices
+		// Access layer or its child. Access describes indices of layers in structure and access_idx the index within that indices.
+		// Non-const version copies shared layers on the path
 		std::shared_ptr<const Layer> access(const std::vector<unsigned int>& r_access, unsigned int access_idx = 0) const;
 		std::shared_ptr<Layer> access(const std::vector<unsigned int>& r_access, unsigned int access_idx = 0);
 
-		// Get own layer mask with removed children pixels. In viewport space, 8bit gray depth
+		// Get own layer mask with removed children pixels. In viewport space, 8bit gray depth.
+		// Mask is cached in compact form per layer and rasterized on each call
 		cv::Mat get_view_mask() const;
+
+		// Get rect covering the white pixels of the layer mask, without rasterizing the mask. In viewport space
+		cv::Rect get_view_mask_rect() const;
+
+		// Check whether point in viewport space is white in the layer mask. Tests the rects of layer and children, without creating any mask
+		bool is_in_view_mask(int view_x, int view_y) const;
 		
 		// Getter
 		LayerType get_type()		const { return _type; }
-		std::string get_xpath()		const { return _xpath; }
+		const std::string& get_xpath()	const { return get_interned_xpath(_xpath_id); }
+		XPathId get_xpath_id()		const { return _xpath_id; } // equal for equal xpaths
 		cv::Point2i get_view_pos()	const { return _view_pos; }
 		int get_view_width()		const { return _view_width; }
 		int get_view_height()		const { return _view_height; }
@@ -125,10 +148,10 @@ namespace data
 
 		// Setter (view is short term for viewport)
 		void set_type(LayerType type)			{ _type = type; }
-		void set_xpath(std::string xpath)		{ _xpath = xpath; }
-		void set_view_pos(cv::Point2i view_pos)	{ _view_pos = view_pos; }
-		void set_view_width(int view_width)		{ _view_width = view_width; }
-		void set_view_height(int view_height)	{ _view_height = view_height; }
+		void set_xpath(const std::string& r_xpath)	{ _xpath_id = intern_xpath(r_xpath); }
+		void set_view_pos(cv::Point2i view_pos)	{ _view_pos = view_pos; invalidate_view_mask(); }
+		void set_view_width(int view_width)		{ _view_width = view_width; invalidate_view_mask(); update_root_view_size(); }
+		void set_view_height(int view_height)	{ _view_height = view_height; invalidate_view_mask(); update_root_view_size(); }
 		void set_scroll_x(int scroll_x)			{ _scroll_x = std::max(0, scroll_x); }
 		void set_scroll_y(int scroll_y)			{ _scroll_y = std::max(0, scroll_y); }
 		void set_zindex(int zindex)				{ _zindex = zindex; }
@@ -147,26 +170,54 @@ namespace data
 		// Get width and height of root elements (considered to be same as web view)
 		void get_view_size_of_root(int& r_width, int& r_height) const;
 
+		// Tell descendants about changed view size, if this layer is a root
+		void update_root_view_size();
+
+		// Set view size of root for this layer and its descendants
+		void set_root_view_size(int root_view_width, int root_view_height);
+
+		// Get child to modify it, copies child if not owned by the owner of this layer. Invalidates own mask, as geometry of child might be modified
+		std::shared_ptr<Layer>& mutable_child(unsigned int idx);
+
+		// Copy layer for the owner, children are shared
+		std::shared_ptr<Layer> copy_for(std::uint64_t owner) const;
+
+		// Create owner that has not been used before. Thread-safe
+		static std::uint64_t create_owner();
+
 		// Get simple layer mask (without removed children etc.). Not const return, may be further used!
 		cv::Mat get_simple_view_mask() const;
 
 		// Get accumulated mask of children and their children. Not const return, may be further used! Matrix might be empty with zero sizes
 		cv::Mat get_children_view_mask() const;
 
+		// Check whether point in viewport space is white in the simple layer mask
+		bool is_in_simple_view_mask(int view_x, int view_y) const;
+
+		// Check whether point in viewport space is white in the accumulated mask of children and their children
+		bool is_in_children_view_mask(int view_x, int view_y) const;
+
+		// Get cached compact mask, creates it if not yet cached. Thread-safe
+		struct CompactViewMask;
+		std::shared_ptr<const CompactViewMask> get_compact_view_mask() const;
+
+		// Forget cached compact mask, required when geometry of layer or its descendants changes
+		void invalidate_view_mask();
+
 	private:
 
 		// Private constructor
 		Layer() {}
 
-		// Private copy constructor with default function (used for deep copy)
-		Layer(const Layer&) = default;
+		// Private copy constructor (used for copy-on-write, children are shared). Reads cached mask atomically
+		Layer(const Layer& r_other);
 
 		// Private assignment constructor
 		Layer& operator=(const Layer&) = delete;
 
 		// (Simple) members
 		LayerType _type = LayerType::None;
-		std::string _xpath = "";
+		XPathId _xpath_id = 0; // interned xpath, empty by default
 		cv::Point2i _view_pos = cv::Point2i(0, 0); // upper left corner within web view in screencast frame
 		int _view_width = 0; // width of visible potion in viewport
 		int _view_height = 0; // height of visible potion viewport
@@ -174,11 +225,17 @@ namespace data
 		int _scroll_y = 0; // relative vertical scrolling in relation to parent, positive value
 		int _zindex = 0; // z-index according to DOM
 
-		// Shared members (must be treated special at deep copy)
-		std::weak_ptr<const Layer> _wp_parent = std::weak_ptr<const Layer>();
-		std::vector<std::shared_ptr<Layer> > _children; // order is important, are accessed by index
+		// Layer tree (instead of pointer to parent, as layers might have multiple parents)
+		bool _is_child = false; // whether layer has been appended to a parent
+		int _root_view_width = 0; // view width of root, if layer is child
+		int _root_view_height = 0; // view height of root, if layer is child
+		std::vector<std::shared_ptr<Layer> > _children; // order is important, are accessed by index. Might be shared with other layer trees
+		std::uint64_t _owner = 0; // layer tree that modifies the layer in place, zero if layer has not been copied for a tree
+
+		// Cached mask, accessed atomically as layers are shared among threads. Copies share the cached mask
+		mutable std::shared_ptr<const CompactViewMask> _sp_view_mask = nullptr;
 
-		// Members that are filled afterwards by parser. May not be considered in the deep copy process, as filled later
+		// Members that are filled afterwards by parser
 		std::vector<std::shared_ptr<const Input> > _input;
 	};
 }
@@ -0,0 +1,102 @@
+#include "LayerTree.hpp"
+#include <Data/LogDatum.hpp>
+#include <stdexcept>
+
+namespace data
+{
+	const LayerNode& FlatLayerTree::get_node(unsigned int node_idx) const
+	{
+		if (node_idx >= _node_count)
+		{
+			throw std::out_of_range("Flat layer tree has no node with index " + std::to_string(node_idx));
+		}
+		return _p_nodes[node_idx];
+	}
+
+	unsigned int FlatLayerTree::find(const std::vector<unsigned int>& r_access) const
+	{
+		unsigned int node_idx = 0; // root
+		for (unsigned int child_idx : r_access)
+		{
+			const auto& r_node = get_node(node_idx);
+			if (child_idx >= r_node.child_count)
+			{
+				throw std::out_of_range("Flat layer tree has no child with index " + std::to_string(child_idx));
+			}
+			node_idx = r_node.first_child + child_idx;
+		}
+		return node_idx;
+	}
+
+	std::vector<unsigned int> FlatLayerTree::get_access(unsigned int node_idx) const
+	{
+		const auto* p_node = &get_node(node_idx);
+		std::vector<unsigned int> access(p_node->depth);
+		for (unsigned int i = p_node->depth; i > 0; --i) // fill from back to front
+		{
+			access[i - 1] = p_node->child_idx;
+			p_node = &_p_nodes[p_node->parent];
+		}
+		return access;
+	}
+
+	std::shared_ptr<const Layer> LayerArena::access_layer(unsigned int frame_idx, const std::vector<unsigned int>& r_access) const
+	{
+		return _layer_packs.at(frame_idx).at(_trees.at(frame_idx).find(r_access)).sptr; // packs are in the order of the nodes
+	}
+
+	LayerArena::LayerArena(const std::vector<std::shared_ptr<const LogDatum> >& r_log_dates)
+	{
+		// Flatten each tree in breadth-first order, so children of a node are appended contiguously
+		std::vector<unsigned int> offsets;
+		offsets.reserve(r_log_dates.size() + 1);
+		for (const auto& rsp_log_datum : r_log_dates)
+		{
+			unsigned int offset = (unsigned int)_nodes.size();
+			offsets.push_back(offset);
+
+			// Push back root
+			LayerNode root;
+			root.p_layer = rsp_log_datum->get_root().get();
+			_nodes.push_back(root);
+
+			// Go over nodes of this tree in the order they are appended
+			for (unsigned int node_idx = 0; offset + node_idx < (unsigned int)_nodes.size(); ++node_idx)
+			{
+				const Layer* p_layer = _nodes[offset + node_idx].p_layer;
+				unsigned int child_count = p_layer->get_child_count();
+				unsigned int depth = _nodes[offset + node_idx].depth;
+				_nodes[offset + node_idx].first_child = (unsigned int)_nodes.size() - offset;
+				_nodes[offset + node_idx].child_count = child_count;
+				for (unsigned int child_idx = 0; child_idx < child_count; ++child_idx)
+				{
+					LayerNode child;
+					child.p_layer = p_layer->get_child(child_idx).get(); // kept alive by root
+					child.parent = node_idx;
+					child.child_idx = child_idx;
+					child.depth = depth + 1;
+					_nodes.push_back(child);
+				}
+			}
+		}
+		offsets.push_back((unsigned int)_nodes.size());
+
+		// Create views into nodes, which are no longer reallocated, and tables of layer packs
+		_trees.reserve(r_log_dates.size());
+		_layer_packs.resize(r_log_dates.size());
+		for (unsigned int i = 0; i < (unsigned int)r_log_dates.size(); ++i)
+		{
+			_trees.push_back(FlatLayerTree(
+				r_log_dates.at(i)->get_root(),
+				_nodes.data() + offsets.at(i),
+				offsets.at(i + 1) - offsets.at(i)));
+			const auto& r_tree = _trees.back();
+			auto& r_packs = _layer_packs.at(i);
+			r_packs.reserve(r_tree.get_node_count());
+			for (unsigned int node_idx = 0; node_idx < r_tree.get_node_count(); ++node_idx)
+			{
+				r_packs.push_back(LayerPack(r_tree.get_access(node_idx), r_tree.access(node_idx)->shared_from_this()));
+			}
+		}
+	}
+}
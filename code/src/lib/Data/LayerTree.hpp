@@ -0,0 +1,108 @@
+//! Flat layer tree.
+/*!
+Read-only, flat representation of the layer trees of log dates. Nodes of all log dates of a container are allocated
+in one arena, links between nodes are indices. Nodes are stored in breadth-first order, thus the children of a node
+are contiguous and a layer is accessed by its node index in constant time.
+The arena also holds a table of layer packs per log datum, so the layer tree is traversed once per container.
+*/
+
+#pragma once
+
+#include <Data/Layer.hpp>
+#include <memory>
+#include <vector>
+
+namespace data
+{
+	// Forward declaration
+	class LogDatum;
+
+	// Node of a flat layer tree
+	struct LayerNode
+	{
+		const Layer* p_layer = nullptr; // kept alive by the root layer of the flat layer tree
+		unsigned int parent = 0; // node index of parent, root is its own parent
+		unsigned int first_child = 0; // node index of first child, children are contiguous
+		unsigned int child_count = 0; // count of children
+		unsigned int child_idx = 0; // index within children of parent, as used in access paths
+		unsigned int depth = 0; // length of access path, zero for root
+	};
+
+	// Struct to store how to access a layer via indices for general and the direct pointer for local processing
+	struct LayerPack
+	{
+		LayerPack(std::vector<unsigned int> access, std::shared_ptr<const Layer> sptr) :
+			access(access), sptr(sptr) {}
+
+		std::vector<unsigned int> access; // empty for root
+		std::shared_ptr<const Layer> sptr; // should be only used for local actions, not easy serializable
+	};
+
+	// Typedef
+	typedef std::vector<LayerPack> LayerPacks;
+
+	// Flat layer tree of one log datum, view into nodes allocated by a layer arena
+	class FlatLayerTree
+	{
+	public:
+
+		// Constructor, taking the nodes of the tree. Root layer keeps the layers of the nodes alive
+		FlatLayerTree(std::shared_ptr<const Layer> sp_root, const LayerNode* p_nodes, unsigned int node_count)
+			: _sp_root(sp_root), _p_nodes(p_nodes), _node_count(node_count) {}
+
+		// Get count of nodes (for iteration, root has index zero)
+		unsigned int get_node_count() const { return _node_count; }
+
+		// Get node by its index. Throws if index is out of range
+		const LayerNode& get_node(unsigned int node_idx) const;
+
+		// Access layer by node index. Throws if index is out of range
+		const Layer* access(unsigned int node_idx) const { return get_node(node_idx).p_layer; }
+
+		// Find node index of layer accessed by indices navigating through the tree of layers. Throws if there is no such layer
+		unsigned int find(const std::vector<unsigned int>& r_access) const;
+
+		// Get indices navigating through the tree of layers to the node
+		std::vector<unsigned int> get_access(unsigned int node_idx) const;
+
+		// Get root layer
+		std::shared_ptr<const Layer> get_root() const { return _sp_root; }
+
+	private:
+
+		// Members
+		std::shared_ptr<const Layer> _sp_root = nullptr;
+		const LayerNode* _p_nodes = nullptr; // owned by arena
+		unsigned int _node_count = 0;
+	};
+
+	// Arena allocating the nodes of the flat layer trees of log dates at once. Immutable after construction
+	class LayerArena
+	{
+	public:
+
+		// Constructor, flattens the layer trees of the log dates
+		LayerArena(const std::vector<std::shared_ptr<const LogDatum> >& r_log_dates);
+
+		// Access layer of log datum by frame index and indices navigating through the tree of layers, without walking
+		// the layers themselves. Throws if there is no such layer
+		std::shared_ptr<const Layer> access_layer(unsigned int frame_idx, const std::vector<unsigned int>& r_access) const;
+
+		// Get layer packs of log datum by frame index, in breadth-first order of the layer tree. Throws if index is out of range
+		const LayerPacks& get_layer_packs(unsigned int frame_idx) const { return _layer_packs.at(frame_idx); }
+
+		// Get count of flat layer trees
+		unsigned int get_tree_count() const { return (unsigned int)_trees.size(); }
+
+	private:
+
+		// Remove copy and assignment operators
+		LayerArena(const LayerArena&) = delete;
+		LayerArena& operator=(const LayerArena&) = delete;
+
+		// Members
+		std::vector<LayerNode> _nodes; // nodes of all trees, not reallocated after construction
+		std::vector<FlatLayerTree> _trees; // one per log datum
+		std::vector<LayerPacks> _layer_packs; // one table per log datum, same order as nodes
+	};
+}
@@ -3,6 +3,7 @@
 #include <Core/Core.hpp>
 #include <Data/Session.hpp>
 #include <Data/Layer.hpp>
+#include <Data/LayerTree.hpp>
 #include <opencv2/core/types.hpp>
 #include <memory>
 #include <string>
@@ -24,36 +25,55 @@ namespace data
 			_sp_root = Layer::create();
 			_sp_root->set_type(data::LayerType::Root);
 			_sp_root->set_xpath("html"); // html is root, body might be already a fixed layer
+			_sp_root->_owner = _owner; // root is not shared
 		}
 
-		// Deep copy of log datum, including the frame time
-		std::unique_ptr<LogDatum> deep_copy() const
+		// Constructor with given root layer and viewport, e.g., when restored from a snapshot. Root layer may be shared
+		LogDatum(
+			double frame_time,
+			std::shared_ptr<Layer> sp_root,
+			cv::Point2i viewport_on_screen_pos,
+			cv::Point2i viewport_pos,
+			int viewport_width,
+			int viewport_height)
+			:
+			_sp_root(sp_root),
+			_frame_time(frame_time),
+			_viewport_on_screen_pos(viewport_on_screen_pos),
+			_viewport_pos(viewport_pos),
+			_viewport_width(viewport_width),
+			_viewport_height(viewport_height)
+			{}
+
+		// Copy of log datum, including the frame time
+		std::unique_ptr<LogDatum> copy() const
 		{
-			return deep_copy(this->_frame_time);
+			return copy(this->_frame_time);
 		}
 
-		// Deep copy of log datum. Taking frame time of corresponding (new) frame in the screencast
-		std::unique_ptr<LogDatum> deep_copy(double frame_time) const
+		// Copy of log datum. Taking frame time of corresponding (new) frame in the screencast.
+		// Layers are shared with this log datum and copied on write, thus the copy behaves like a deep copy.
+		// Not thread-safe with other copies or non-const access of this log datum, as both give up the ownership of their layers
+		std::unique_ptr<LogDatum> copy(double frame_time) const
 		{
-			// Start of with simple copy, does not yet deep copy the layers
 			std::unique_ptr<LogDatum> up_clone = std::unique_ptr<LogDatum>(new LogDatum(*this)); // call standard copy constructor
 			up_clone->_frame_time = frame_time;
-
-			// Deep copy the layer structure
-			up_clone->_sp_root = std::shared_ptr<Layer>(new Layer(*(up_clone->_sp_root)));
-			recursive_deep_copy_layer_children(up_clone->_sp_root);
-
-			// Return deep copy
+			up_clone->_owner = Layer::create_owner();
+			_owner = Layer::create_owner(); // layers are now shared, thus this log datum copies them on write, too
 			return up_clone;
 		}
 
-		// Get root layer
+		// Get root layer. Non-const version copies the root layer if not owned by this log datum
 		std::shared_ptr<const Layer> get_root() const
 		{
 			return _sp_root;
 		}
 		std::shared_ptr<Layer> get_root()
 		{
+			if (_sp_root->_owner != _owner) // root might be shared with other log dates
+			{
+				_sp_root = _sp_root->copy_for(_owner);
+			}
 			return _sp_root;
 		}
 
@@ -64,7 +84,7 @@ namespace data
 		}
 		std::shared_ptr<Layer> access_layer(const std::vector<unsigned int>& r_access)
 		{
-			return _sp_root->access(r_access);
+			return get_root()->access(r_access);
 		}
 
 		// Getter
@@ -77,8 +97,8 @@ namespace data
 		// Setter
 		void set_viewport_on_screen_position(cv::Point2i viewport_pos)	{ _viewport_on_screen_pos = viewport_pos; }
 		void set_viewport_pos(cv::Point2i viewport_pos)					{ _viewport_pos = viewport_pos; }
-		void set_viewport_width(int viewport_width)						{ _viewport_width = viewport_width; _sp_root->set_view_width(viewport_width); }
-		void set_viewport_height(int viewport_height)					{ _viewport_height = viewport_height; _sp_root->set_view_height(viewport_height); }
+		void set_viewport_width(int viewport_width)						{ _viewport_width = viewport_width; get_root()->set_view_width(viewport_width); }
+		void set_viewport_height(int viewport_height)					{ _viewport_height = viewport_height; get_root()->set_view_height(viewport_height); }
 		
 		// Create visual debug datum
 		VD(std::shared_ptr<core::visual_debug::Datum> create_visual_debug_datum() const
@@ -97,29 +117,14 @@ namespace data
 	private:
 
 		// Private copy constructor with default implementation
-		LogDatum(const LogDatum&) = default; // required for deep copy
+		LogDatum(const LogDatum&) = default; // required for copy, shares the root layer
 
 		// Private assignment constructor
 		LogDatum& operator=(const LogDatum&) = delete;
 
-		// Recursive helper for deep copy
-		void recursive_deep_copy_layer_children(std::shared_ptr<Layer> sp_layer) const
-		{
-			auto children = sp_layer->_children; // remember children of layer
-			sp_layer->_children.clear(); // clear children in layer
-			sp_layer->_wp_parent = std::weak_ptr<const Layer>(); // clear parent
-
-			// Go over children and deep copy them
-			for (const auto& rsp_child : children)
-			{
-				auto sp_child = std::shared_ptr<Layer>(new Layer(*rsp_child)); // call standard copy constructor on layer
-				recursive_deep_copy_layer_children(sp_child); // perform deep copy of children of child
-				sp_layer->append_child(sp_child); // append now deep copied child
-			}
-		}
-
 		// Members
-		std::shared_ptr<Layer> _sp_root = nullptr; // future root node, see constructor
+		std::shared_ptr<Layer> _sp_root = nullptr; // future root node, see constructor. Might be shared with other log dates
+		mutable std::uint64_t _owner = Layer::create_owner(); // owner of the layers this log datum modifies in place, renewed when copied
 		double _frame_time = 0.0; // time of corresponding frame in screencast in seconds
 		cv::Point2i _viewport_on_screen_pos = cv::Point2i(0,0); // viewport position on screen (required to transform, i.e., gaze data)
 		cv::Point2i _viewport_pos = cv::Point2i(0,0); // upper left corner of viewport in screencast frame (should be (0,0) if only viewport is recorded in screencast)
@@ -151,10 +156,15 @@ namespace data
 		{
 			_sp_log_dates->push_back(sp_log_datum);
 			_sp_log_dates_const = nullptr;
+			std::atomic_store(&_sp_layer_arena, std::shared_ptr<const LayerArena>());
 		}
 		
-		// Get log dates
-		std::shared_ptr<LogDates> get() { return _sp_log_dates; }
+		// Get log dates. Non-const version forgets the layer arena, as log dates might be modified
+		std::shared_ptr<LogDates> get()
+		{
+			std::atomic_store(&_sp_layer_arena, std::shared_ptr<const LayerArena>());
+			return _sp_log_dates;
+		}
 		std::shared_ptr<LogDates_const> get() const
 		{
 			if (_sp_log_dates_const == nullptr)
@@ -164,6 +174,18 @@ namespace data
 			return _sp_log_dates_const;
 		}
 
+		// Get flat layer trees of all log dates, allocated in one arena. Created on first call. Thread-safe
+		std::shared_ptr<const LayerArena> get_layer_arena() const
+		{
+			auto sp_arena = std::atomic_load(&_sp_layer_arena);
+			if (sp_arena == nullptr)
+			{
+				sp_arena = std::make_shared<LayerArena>(*get()); // concurrent callers might create the same arena, last one is kept
+				std::atomic_store(&_sp_layer_arena, sp_arena);
+			}
+			return sp_arena;
+		}
+
 		// Get session
 		std::shared_ptr<const Session> get_session() const { return _sp_session; }
 		
@@ -181,6 +203,7 @@ namespace data
 		double _datacast_duration = 0.0; // duration of record according to the .json in seconds
 		std::shared_ptr<LogDates> _sp_log_dates = std::make_shared<LogDates>();
 		mutable std::shared_ptr<LogDates_const> _sp_log_dates_const = nullptr; // is updated if required by getter
+		mutable std::shared_ptr<const LayerArena> _sp_layer_arena = nullptr; // is created if required by getter, accessed atomically
 	};
 	
 	// Typedefs
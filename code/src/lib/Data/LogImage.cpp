@@ -3,8 +3,12 @@
 
 namespace data
 {
-	LogImage::LogImage(const simplewebm::Image& r_screenshot, std::shared_ptr<const LogDatum> sp_log_datum)
+	LogImage::LogImage(std::shared_ptr<const simplewebm::Image> sp_screenshot, std::shared_ptr<const LogDatum> sp_log_datum)
+		:
+		_sp_screenshot(sp_screenshot)
 	{
+		const simplewebm::Image& r_screenshot = *_sp_screenshot.get();
+
 		// Prepare some variables
 		cv::Rect viewport_rect( // raw viewport coordinates (in screen coordinates)
 			sp_log_datum->get_viewport_pos().x,
@@ -39,17 +43,46 @@ namespace data
 			CV_8UC3,
 			const_cast<char *>(r_screenshot.data.data()));
 
-		// Crop and convert (and copy) pixels of viewport. Turns BGR to BGRA
-		cv::cvtColor(screen_pixels(viewport_in_screen_rect), _viewport_pixels, cv::COLOR_BGR2BGRA); // only take pixels of viewport and add alpha channel
-		
-		// Create gray version of viewport pixels
-		core::opencv::BGRA2Y(_viewport_pixels, _viewport_pixels_gray);
+		// Refer to pixels of viewport (no copy)
+		_viewport_pixels_bgr = screen_pixels(viewport_in_screen_rect);
+	}
+
+	const cv::Mat LogImage::get_viewport_pixels() const
+	{
+		std::call_once(_viewport_pixels_flag, [this]()
+		{
+			// Convert (and copy) pixels of viewport. Turns BGR to BGRA
+			cv::cvtColor(_viewport_pixels_bgr, _viewport_pixels, cv::COLOR_BGR2BGRA);
+		});
+		return _viewport_pixels;
+	}
+
+	const cv::Mat LogImage::get_viewport_pixels_gray() const
+	{
+		std::call_once(_viewport_pixels_gray_flag, [this]()
+		{
+			// Create gray version of viewport pixels. Same as core::opencv::BGRA2Y on the BGRA pixels,
+			// which has nothing to fill as the viewport has no transparent pixels
+			cv::Mat yuv;
+			cv::cvtColor(_viewport_pixels_bgr, yuv, cv::COLOR_BGR2YUV);
+			cv::extractChannel(yuv, _viewport_pixels_gray, 0);
+		});
+		return _viewport_pixels_gray;
 	}
 
 	const cv::Mat LogImage::get_layer_pixels(const cv::Mat layer_view_mask) const
 	{
-		cv::Mat layer_pixels = cv::Mat::zeros(_viewport_pixels.size(), _viewport_pixels.type()); // initialize empty image
-		core::opencv::blend(_viewport_pixels, layer_pixels, layer_view_mask, layer_pixels); // blend pixels onto it
+		cv::Mat layer_pixels;
+		get_layer_pixels(layer_view_mask, layer_pixels);
 		return layer_pixels;
 	}
+
+	void LogImage::get_layer_pixels(const cv::Mat& r_layer_view_mask, cv::Mat& r_out) const
+	{
+		// Copying with a binary mask equals blending the pixels onto an empty image
+		const cv::Mat viewport_pixels = get_viewport_pixels();
+		r_out.create(viewport_pixels.size(), viewport_pixels.type());
+		r_out.setTo(cv::Scalar::all(0));
+		viewport_pixels.copyTo(r_out, r_layer_view_mask);
+	}
 }
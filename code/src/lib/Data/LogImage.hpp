@@ -5,12 +5,13 @@
 #include <opencv2/opencv.hpp>
 #include <libsimplewebm.hpp>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 // do not serialize, too much data if stored as raw image
 // holds viewport pixels from screencast according to information from the datacast (e.g., maybe crop viewport from screenshot)
-// holds 8bit BGRA pixel data
+// refers to the decoded 8bit BGR screenshot without copying, 8bit BGRA and gray pixel data are created on first access
 
 namespace data
 {
@@ -18,28 +19,34 @@ namespace data
 	{
 	public:
 
-		// Constructor. Copies pixel data of screenshot into member structure
-		LogImage(const simplewebm::Image& r_screenshot, std::shared_ptr<const LogDatum> sp_log_datum);
+		// Constructor. Keeps the screenshot and refers to its viewport pixels
+		LogImage(std::shared_ptr<const simplewebm::Image> sp_screenshot, std::shared_ptr<const LogDatum> sp_log_datum);
 
-		// Get pixels of viewport
-		const cv::Mat get_viewport_pixels() const
-		{
-			return _viewport_pixels;
-		}
+		// Get pixels of viewport as 4 channel 8 bit depth image. Thread-safe
+		const cv::Mat get_viewport_pixels() const;
 		
-		// Get pixels of viewport in gray
-		const cv::Mat get_viewport_pixels_gray() const
-		{
-			return _viewport_pixels_gray;
-		}
+		// Get pixels of viewport in gray. Thread-safe
+		const cv::Mat get_viewport_pixels_gray() const;
 
 		// Get pixels of a layer as 4 channel 8 bit depth image. Size of matrix is viewport size, alpha value of non-layer pixels is zero.
 		// Frame of layer must match with frame of log image
 		const cv::Mat get_layer_pixels(const cv::Mat layer_view_mask) const;
 
+		// Same as above but writes into the provided matrix, which is only reallocated if it does not fit.
+		// Expects a binary mask (zero or 255), like the view masks of layers
+		void get_layer_pixels(const cv::Mat& r_layer_view_mask, cv::Mat& r_out) const;
+
 	private:
 
-		cv::Mat _viewport_pixels; // pixels of the viewport
-		cv::Mat _viewport_pixels_gray; // pixels of the viewport in gray
+		// Remove copy and assignment operators
+		LogImage(const LogImage&) = delete;
+		LogImage& operator=(const LogImage&) = delete;
+
+		std::shared_ptr<const simplewebm::Image> _sp_screenshot = nullptr; // decoded screenshot
+		cv::Mat _viewport_pixels_bgr; // pixels of the viewport, refers to data of screenshot
+		mutable std::once_flag _viewport_pixels_flag;
+		mutable cv::Mat _viewport_pixels; // pixels of the viewport in BGRA
+		mutable std::once_flag _viewport_pixels_gray_flag;
+		mutable cv::Mat _viewport_pixels_gray; // pixels of the viewport in gray
 	};
 }
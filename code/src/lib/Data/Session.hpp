@@ -1,5 +1,6 @@
 #pragma once
 
+#include <Data/FrameCache.hpp>
 #include <memory>
 #include <string>
 #include <vector>
@@ -13,13 +14,15 @@ namespace data
 	
 		// Constructor
 		Session(std::string id, std::string webm_path, std::string json_path, int frame_limit = -1)
-			: _id(id), _webm_path(webm_path), _json_path(json_path), _frame_limit(frame_limit) {}
+			: _id(id), _webm_path(webm_path), _json_path(json_path), _frame_limit(frame_limit),
+			_sp_frame_cache(std::make_shared<FrameCache>(webm_path)) {}
 		
 		// Getter
 		std::string get_id() const { return _id; }
 		std::string get_webm_path() const { return _webm_path; }
 		std::string get_json_path() const { return _json_path; }
 		int get_frame_limit() const { return _frame_limit; }
+		std::shared_ptr<FrameCache> get_frame_cache() const { return _sp_frame_cache; } // decoded frames of screencast, shared by all stages
 		
 	private:
 	
@@ -34,6 +37,7 @@ namespace data
 		std::string _webm_path = ""; // screencast
 		std::string _json_path = ""; // datacast
 		int _frame_limit = -1; // limits amount of considered frames. -1 if there is no limit
+		std::shared_ptr<FrameCache> _sp_frame_cache = nullptr; // decoded frames, see frame cache for when stages share the decoding
 	};
 	
 	// Typedefs
@@ -2,7 +2,7 @@
 
 namespace data
 {
-	State::State(cv::Mat stitched_screenshot) : _stitched_screenshot(stitched_screenshot)
+	State::State(cv::Mat stitched_screenshot) : _canvas(stitched_screenshot), _stitched_screenshot(stitched_screenshot)
 	{
 		// Remember to update covered rect as stitched screenshot has been updated
 		_update_covered_rect = true;
@@ -12,26 +12,58 @@ namespace data
 	
 	void State::set_stitched_screenshot(cv::Mat stitched_screenshot)
 	{
+		std::lock_guard<std::mutex> lock(_canvas_mutex);
+		_canvas = TiledCanvas(stitched_screenshot); // tiles are views, cloned when written
 		_stitched_screenshot = stitched_screenshot;
 
 		// Remember to update covered rect as stitched screenshot has been updated
 		_update_covered_rect = true;
 	}
+
+	void State::write_stitched_screenshot(cv::Rect rect, const cv::Mat& pixels, const cv::Mat& mask)
+	{
+		std::lock_guard<std::mutex> lock(_canvas_mutex);
+		_canvas.write(rect, pixels, mask);
+		_stitched_screenshot = cv::Mat(); // flattened again when requested
+
+		// Remember to update covered rect as stitched screenshot has been updated
+		_update_covered_rect = true;
+	}
 	
 	const cv::Mat State::get_stitched_screenshot() const
 	{
+		std::lock_guard<std::mutex> lock(_canvas_mutex);
+
+		// Flatten tiles and let them view the flattened pixels, so a flattened state keeps its pixels only once
+		if (_stitched_screenshot.empty() && _canvas.get_width() > 0 && _canvas.get_height() > 0)
+		{
+			_stitched_screenshot = _canvas.flatten();
+			_canvas = TiledCanvas(_stitched_screenshot);
+		}
 		return _stitched_screenshot;
 	}
 
+	cv::Mat State::get_stitched_screenshot_roi(cv::Rect roi) const
+	{
+		std::lock_guard<std::mutex> lock(_canvas_mutex);
+		return _canvas.read(roi);
+	}
+
+	cv::Size State::get_stitched_screenshot_size() const
+	{
+		std::lock_guard<std::mutex> lock(_canvas_mutex);
+		return _canvas.size();
+	}
+
 	const cv::Mat State::get_covered_stitched_screenshot() const
 	{
 		// Update covered rect if required (TODO: mut const looks dangerous for multi-threading)
 		if (_update_covered_rect)
 		{
-			_covered = core::opencv::covering_rect_bgra(_stitched_screenshot);
+			_covered = core::opencv::covering_rect_bgra(get_stitched_screenshot());
 			_update_covered_rect = false;
 		}
 
-		return _stitched_screenshot(_covered);
+		return get_stitched_screenshot()(_covered);
 	}
 }
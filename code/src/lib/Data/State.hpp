@@ -1,8 +1,10 @@
 #pragma once
 
 #include <Core/Core.hpp>
+#include <Data/TiledCanvas.hpp>
 #include <opencv2/core/types.hpp>
 #include <opencv2/opencv.hpp>
+#include <mutex>
 
 namespace data
 {
@@ -21,12 +23,23 @@ namespace data
 		// Making the class abstract
 		virtual ~State() = 0;
 		
-		// Set stitched screenshot
+		// Set stitched screenshot, takes matrix as reference (does not copy!)
 		void set_stitched_screenshot(cv::Mat stitched_screenshot);
+
+		// Write pixels into rect of stitched screenshot, growing it if required. Only pixels where the mask is non-zero are written
+		void write_stitched_screenshot(cv::Rect rect, const cv::Mat& pixels, const cv::Mat& mask = cv::Mat());
 		
-		// Get reference to stitched screenshot
+		// Get reference to stitched screenshot. Flattens the tiled stitched screenshot if it has been written since the last call.
+		// Returned matrix is not changed by later writes
 		const cv::Mat get_stitched_screenshot() const;
 
+		// Get rect of stitched screenshot. Returns a view into the stitched screenshot if the rect is within one of its tiles,
+		// otherwise a matrix of the size of the rect that is zero where the rect is out of bounds. A view is changed by later writes
+		cv::Mat get_stitched_screenshot_roi(cv::Rect roi) const;
+
+		// Get size of stitched screenshot
+		cv::Size get_stitched_screenshot_size() const;
+
 		// Get reference to covered stitched screenshot.
 		// Returns reference to covered rectangular part of the stitched screenshot matrix
 		// TODO: This function is not threadsafe - but this is not required atm
@@ -46,8 +59,10 @@ namespace data
 		// Delete assignment constructor
 		State& operator=(const State&) = delete;
 	
-		// Members
-		cv::Mat _stitched_screenshot; // matrix with pixels of stitched screenshot
+		// Members (mutable because stitched screenshot is flattened in getter const method)
+		mutable TiledCanvas _canvas; // tiles with pixels of stitched screenshot
+		mutable cv::Mat _stitched_screenshot; // flattened stitched screenshot, empty if canvas has been written since flattening
+		mutable std::mutex _canvas_mutex; // guards canvas and flattened stitched screenshot, as states are read concurrently in merging
 
 		// Covering rectangle (mutable because may be changed in getter const method)
 		mutable cv::Rect _covered;
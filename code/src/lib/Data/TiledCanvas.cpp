@@ -0,0 +1,126 @@
+#include "TiledCanvas.hpp"
+#include <Core/Core.hpp>
+#include <algorithm>
+#include <cassert>
+
+const int TILE_WIDTH = core::mt::get_config_value(2048, { "general", "tiled_canvas", "tile_width" });
+
+namespace data
+{
+	TiledCanvas::TiledCanvas(int type, int tile_width) :
+		_type(type), _tile_width(tile_width > 0 ? tile_width : std::max(1, TILE_WIDTH)) {}
+
+	TiledCanvas::TiledCanvas(const cv::Mat& pixels, int tile_width) :
+		_type(pixels.type()), _tile_width(tile_width > 0 ? tile_width : std::max(1, TILE_WIDTH)), _width(pixels.cols), _height(pixels.rows)
+	{
+		// Tiles are views into the pixels
+		for (int x = 0; x < _width; x += _tile_width)
+		{
+			Tile tile;
+			tile.pixels = pixels(cv::Rect(x, 0, std::min(_tile_width, _width - x), _height));
+			tile.view = true;
+			_tiles.push_back(tile);
+		}
+	}
+
+	void TiledCanvas::extend(cv::Rect rect)
+	{
+		_width = std::max(_width, rect.x + rect.width);
+		_height = std::max(_height, rect.y + rect.height);
+	}
+
+	void TiledCanvas::write(cv::Rect rect, const cv::Mat& pixels, const cv::Mat& mask)
+	{
+		assert(("TiledCanvas::write: pixels must be as large as the rect",
+			pixels.cols == rect.width && pixels.rows == rect.height && pixels.type() == _type));
+		extend(rect);
+
+		// Go over tiles covered by the rect and copy the corresponding part of the pixels
+		cv::Rect clipped = rect & cv::Rect(0, 0, _width, _height);
+		if (clipped.area() <= 0) { return; }
+		for (int tile_x = clipped.x / _tile_width; tile_x * _tile_width < clipped.x + clipped.width; ++tile_x)
+		{
+			cv::Rect tile_rect(tile_x * _tile_width, 0, _tile_width, clipped.y + clipped.height);
+			cv::Rect part = tile_rect & clipped; // in canvas space
+			cv::Rect source(part.x - rect.x, part.y - rect.y, part.width, part.height);
+			if (!mask.empty() && cv::countNonZero(mask(source)) <= 0) { continue; } // nothing to write, do not allocate tile
+			cv::Mat target = writable_tile(tile_x, part.y + part.height)(cv::Rect(part.x - tile_rect.x, part.y, part.width, part.height));
+			if (mask.empty())
+			{
+				pixels(source).copyTo(target);
+			}
+			else
+			{
+				pixels(source).copyTo(target, mask(source));
+			}
+		}
+	}
+
+	cv::Mat TiledCanvas::read(cv::Rect rect) const
+	{
+		// Rect within allocated rows of one tile is a view
+		if (rect.width > 0 && rect.height > 0 && rect.x >= 0 && rect.y >= 0
+			&& rect.x / _tile_width == (rect.x + rect.width - 1) / _tile_width
+			&& rect.x + rect.width <= _width && rect.y + rect.height <= _height)
+		{
+			int tile_x = rect.x / _tile_width;
+			const Tile* p_tile = get_tile(tile_x);
+			cv::Rect local(rect.x - tile_x * _tile_width, rect.y, rect.width, rect.height);
+			if (p_tile && (local & cv::Rect(0, 0, p_tile->pixels.cols, p_tile->pixels.rows)) == local)
+			{
+				return p_tile->pixels(local);
+			}
+		}
+
+		// Otherwise, copy the allocated parts of the covered tiles
+		cv::Mat output = cv::Mat::zeros(std::max(0, rect.height), std::max(0, rect.width), _type);
+		cv::Rect clipped = rect & cv::Rect(0, 0, _width, _height);
+		if (clipped.area() <= 0) { return output; }
+		for (int tile_x = clipped.x / _tile_width; tile_x * _tile_width < clipped.x + clipped.width; ++tile_x)
+		{
+			const Tile* p_tile = get_tile(tile_x);
+			if (!p_tile) { continue; } // zero
+			cv::Rect tile_rect(tile_x * _tile_width, 0, p_tile->pixels.cols, p_tile->pixels.rows);
+			cv::Rect part = tile_rect & clipped; // in canvas space
+			if (part.area() <= 0) { continue; }
+			p_tile->pixels(cv::Rect(part.x - tile_rect.x, part.y, part.width, part.height))
+				.copyTo(output(cv::Rect(part.x - rect.x, part.y - rect.y, part.width, part.height)));
+		}
+		return output;
+	}
+
+	cv::Mat TiledCanvas::flatten() const
+	{
+		return read(cv::Rect(0, 0, _width, _height));
+	}
+
+	cv::Mat TiledCanvas::writable_tile(int tile_x, int rows)
+	{
+		// Grow tiles
+		if ((int)_tiles.size() <= tile_x) { _tiles.resize(tile_x + 1); }
+		auto& r_tile = _tiles.at(tile_x);
+
+		// Allocate buffer of full width and enough rows, keeping the pixels of a view or of a smaller tile. Rows are doubled
+		// when growing, so writes of a growing canvas copy each pixel only a constant amount of times
+		rows = std::max(rows, r_tile.pixels.rows);
+		if (r_tile.view || r_tile.buffer.rows < rows || r_tile.buffer.cols != _tile_width)
+		{
+			int capacity = r_tile.view ? rows : std::max(rows, 2 * r_tile.buffer.rows);
+			cv::Mat buffer = cv::Mat::zeros(capacity, _tile_width, _type);
+			if (!r_tile.pixels.empty())
+			{
+				r_tile.pixels.copyTo(buffer(cv::Rect(0, 0, r_tile.pixels.cols, r_tile.pixels.rows)));
+			}
+			r_tile.buffer = buffer;
+			r_tile.view = false;
+		}
+		r_tile.pixels = r_tile.buffer(cv::Rect(0, 0, _tile_width, rows));
+		return r_tile.pixels;
+	}
+
+	const TiledCanvas::Tile* TiledCanvas::get_tile(int tile_x) const
+	{
+		if (tile_x < 0 || tile_x >= (int)_tiles.size() || _tiles.at(tile_x).pixels.empty()) { return nullptr; }
+		return &_tiles.at(tile_x);
+	}
+}
@@ -0,0 +1,70 @@
+//! Tiled canvas.
+/*!
+Growable matrix of pixels that is split into tiles of fixed width, each spanning the complete height of the canvas.
+Tiles are allocated when first written and grow their rows by doubling, so growing the canvas does not copy existing
+pixels for every write and writes touch only the tiles they cover. Pixels of unallocated rows and tiles are zero.
+As pages are scrolled vertically, tiles at least as wide as the viewport let reads of viewport-sized rects return views.
+A canvas can be created from a matrix without copying it, its tiles are then views that are cloned when written.
+*/
+
+#pragma once
+
+#include <opencv2/core/types.hpp>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+namespace data
+{
+	class TiledCanvas
+	{
+	public:
+
+		// Constructor for empty canvas. Non-positive tile width falls back to the config
+		TiledCanvas(int type = CV_8UC4, int tile_width = -1);
+
+		// Constructor taking matrix as initial pixels (does not copy!). Non-positive tile width falls back to the config
+		TiledCanvas(const cv::Mat& pixels, int tile_width = -1);
+
+		// Get extent of the canvas, covers all rects that have been written or extended to
+		int get_width() const { return _width; }
+		int get_height() const { return _height; }
+		cv::Size size() const { return cv::Size(_width, _height); }
+
+		// Grow extent of canvas to cover the rect. No tiles are allocated
+		void extend(cv::Rect rect);
+
+		// Write pixels into rect, growing the canvas if required. Only pixels where the mask is non-zero are written,
+		// empty mask writes all pixels. Pixels and mask must be as large as the rect. Parts at negative coordinates are ignored
+		void write(cv::Rect rect, const cv::Mat& pixels, const cv::Mat& mask = cv::Mat());
+
+		// Read pixels within rect. Returns a view if the rect lies within the allocated rows of one tile (changed by later
+		// writes), otherwise a matrix of the size of the rect that is zero where the rect is out of bounds or unallocated
+		cv::Mat read(cv::Rect rect) const;
+
+		// Copy all pixels into one matrix of the extent of the canvas
+		cv::Mat flatten() const;
+
+	private:
+
+		// Tile of the canvas, a column of the canvas
+		struct Tile
+		{
+			cv::Mat pixels; // allocated rows from the top, empty if unallocated. Might be narrower than tile width if view at the border of a matrix
+			cv::Mat buffer; // owned pixels with spare rows for growing, pixels view its top rows. Empty if view
+			bool view = false; // whether pixels are a view into a matrix not owned by the canvas, cloned before writing
+		};
+
+		// Get tile for writing with at least the rows, allocates or grows the tile or clones a view. Returns the allocated rows
+		cv::Mat writable_tile(int tile_x, int rows);
+
+		// Get tile for reading, nullptr if unallocated
+		const Tile* get_tile(int tile_x) const;
+
+		// Members
+		int _type;
+		int _tile_width;
+		int _width = 0;
+		int _height = 0;
+		std::vector<Tile> _tiles; // only as many as up to the last allocated tile
+	};
+}
@@ -2,8 +2,12 @@
 
 #include <Stage/Processing/Parser.hpp>
 #include <Stage/Processing/Tuning.hpp>
+#include <Stage/Processing/Snapshot.hpp>
+#include <Stage/Processing/ScrollCache.hpp>
 #include <Core/Core.hpp>
 
+const bool SNAPSHOT = core::mt::get_config_value(true, { "processing", "snapshot", "enable" });
+
 namespace stage
 {
 	namespace processing
@@ -14,6 +18,44 @@ namespace stage
 		{
 			core::mt::log_info("# Processing Stage");
 
+			// Load snapshots of sessions that have been processed before with identical input and config.
+			// Visual debugging requires processing, thus snapshots are not loaded when it is enabled
+			bool use_snapshots = SNAPSHOT;
+			VD(use_snapshots = use_snapshots
+				&& !core::mt::get_config_value(false, { "visual_debug", "enable_for", "parser" })
+				&& !core::mt::get_config_value(false, { "visual_debug", "enable_for", "orb_scroll" });)
+			// Visual debugging of the tuning requires tuning, thus scroll caches are not loaded when it is enabled
+			bool use_scroll_caches = true; // scroll_cache::compute_key checks whether scroll caches are enabled
+			VD(use_scroll_caches = use_scroll_caches
+				&& !core::mt::get_config_value(false, { "visual_debug", "enable_for", "orb_scroll" });)
+
+			// Compute keys of sessions
+			std::vector<std::uint64_t> snapshot_keys(sp_sessions->size(), 0);
+			std::vector<bool> snapshot_keyed(sp_sessions->size(), false);
+			std::vector<std::uint64_t> scroll_cache_keys(sp_sessions->size(), 0);
+			std::vector<bool> scroll_cache_keyed(sp_sessions->size(), false);
+			std::vector<std::shared_ptr<data::LogDatumContainer> > snapshots(sp_sessions->size(), nullptr);
+			for (unsigned int session_idx = 0; session_idx < sp_sessions->size(); ++session_idx)
+			{
+				auto sp_session = sp_sessions->at(session_idx);
+				if (use_scroll_caches)
+				{
+					scroll_cache_keyed.at(session_idx) = scroll_cache::compute_key(*sp_session.get(), scroll_cache_keys.at(session_idx));
+				}
+				if (use_snapshots)
+				{
+					snapshot_keyed.at(session_idx) = snapshot::compute_key(*sp_session.get(), snapshot_keys.at(session_idx));
+					if (snapshot_keyed.at(session_idx))
+					{
+						snapshots.at(session_idx) = snapshot::load(sp_session, snapshot_keys.at(session_idx));
+						if (snapshots.at(session_idx))
+						{
+							core::mt::log_info("Loaded snapshot of session: ", sp_session->get_id());
+						}
+					}
+				}
+			}
+
 			core::mt::log_info("## Parsing");
 
 			// Create empty output of the stage (one log datum container per session)
@@ -23,9 +65,12 @@ namespace stage
 			typedef core::Task<parser::LogRecord, 1> ParserTask;
 			core::TaskContainer<ParserTask> parsers;
 
-			// Create one parser for each session
-			for (auto sp_session : *sp_sessions.get())
+			// Create one parser for each session without snapshot
+			for (unsigned int session_idx = 0; session_idx < sp_sessions->size(); ++session_idx)
 			{
+				if (snapshots.at(session_idx)) { continue; }
+				auto sp_session = sp_sessions->at(session_idx);
+
 				// Create visual debug dump
 				VD(
 				std::shared_ptr<core::visual_debug::Dump> sp_dump = nullptr;
@@ -52,15 +97,40 @@ namespace stage
 				sp_log_datum_containers->push_back(rsp_parser->get_product());
 			}
 
+			// Remember which session each parsed log datum container belongs to
+			std::vector<unsigned int> parsed_session_indices;
+			for (unsigned int session_idx = 0; session_idx < sp_sessions->size(); ++session_idx)
+			{
+				if (!snapshots.at(session_idx)) { parsed_session_indices.push_back(session_idx); }
+			}
+
 			core::mt::log_info("## Tuning");
 
 			// Have one ORBscroll per session
 			typedef core::Task<tuning::ORBscroll, 1> ORBscrollTask;
 			core::TaskContainer<ORBscrollTask> orb_scrolls;
 
-			// Create one ORBscroll for each log dates container
-			for (auto sp_log_dates_container : *sp_log_datum_containers.get())
+			// Apply scroll caches of sessions that have been tuned before with identical input and config
+			std::vector<std::shared_ptr<data::LogDatumContainer> > tuned(sp_sessions->size(), nullptr);
+			for (unsigned int parsed_idx = 0; parsed_idx < sp_log_datum_containers->size(); ++parsed_idx)
+			{
+				unsigned int session_idx = parsed_session_indices.at(parsed_idx);
+				if (scroll_cache_keyed.at(session_idx))
+				{
+					tuned.at(session_idx) = scroll_cache::load(sp_log_datum_containers->at(parsed_idx), scroll_cache_keys.at(session_idx));
+					if (tuned.at(session_idx))
+					{
+						core::mt::log_info("Loaded scroll cache of session: ", sp_sessions->at(session_idx)->get_id());
+					}
+				}
+			}
+
+			// Create one ORBscroll for each log dates container without scroll cache
+			for (unsigned int parsed_idx = 0; parsed_idx < sp_log_datum_containers->size(); ++parsed_idx)
 			{
+				if (tuned.at(parsed_session_indices.at(parsed_idx))) { continue; }
+				auto sp_log_dates_container = sp_log_datum_containers->at(parsed_idx);
+
 				// Create visual debug dump
 				VD (
 				std::shared_ptr<core::visual_debug::Dump> sp_dump = nullptr;
@@ -84,10 +154,32 @@ namespace stage
 			// Report about progress on ORBscroll tasks
 			orb_scrolls.wait_and_report();
 
-			// Collect products for each session
-			for (auto& rsp_orb_scroll : orb_scrolls.get())
+			// Collect products for each session in order of sessions, either from snapshot, scroll cache, or ORBscroll
+			unsigned int orb_scroll_idx = 0;
+			for (unsigned int session_idx = 0; session_idx < sp_sessions->size(); ++session_idx)
 			{
-				sp_log_datum_containers->push_back(rsp_orb_scroll->get_product());
+				if (snapshots.at(session_idx))
+				{
+					sp_log_datum_containers->push_back(snapshots.at(session_idx));
+				}
+				else
+				{
+					auto sp_product = tuned.at(session_idx);
+					bool tuned_now = !sp_product;
+					if (tuned_now)
+					{
+						sp_product = orb_scrolls.get().at(orb_scroll_idx++)->get_product();
+					}
+					if (snapshot_keyed.at(session_idx))
+					{
+						snapshot::store(*sp_product.get(), snapshot_keys.at(session_idx)); // store snapshot for later runs
+					}
+					else if (tuned_now && scroll_cache_keyed.at(session_idx))
+					{
+						scroll_cache::store(*sp_product.get(), scroll_cache_keys.at(session_idx)); // snapshot covers scroll offsets, otherwise store scroll cache for later runs
+					}
+					sp_log_datum_containers->push_back(sp_product);
+				}
 			}
 
 			// Return ready-to-use log dates containers
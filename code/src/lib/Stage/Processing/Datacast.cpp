@@ -0,0 +1,316 @@
+#include "Datacast.hpp"
+#include <nlohmann/json.hpp>
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+
+namespace stage
+{
+	namespace processing
+	{
+		namespace parser
+		{
+			// SAX handler that fills the datacast. Items are the objects within the arrays of the root object
+			class DatacastHandler
+			{
+			public:
+
+				typedef nlohmann::json::number_integer_t number_integer_t;
+				typedef nlohmann::json::number_unsigned_t number_unsigned_t;
+				typedef nlohmann::json::number_float_t number_float_t;
+				typedef nlohmann::json::string_t string_t;
+
+				// Constructor
+				DatacastHandler(Datacast& r_datacast) : _r_datacast(r_datacast) {}
+
+				// Values
+				bool null() { if (item_value()) { _value.kind = Value::Kind::Null; assign(); } return true; }
+				bool boolean(bool) { return true; }
+				bool number_integer(number_integer_t val) { if (item_value()) { _value.kind = Value::Kind::Integer; _value.integer = (core::long64)val; assign(); } return true; }
+				bool number_unsigned(number_unsigned_t val) { if (item_value()) { _value.kind = Value::Kind::Integer; _value.integer = (core::long64)val; assign(); } return true; }
+				bool number_float(number_float_t val, const string_t&) { if (item_value()) { _value.kind = Value::Kind::Float; _value.floating = (double)val; assign(); } return true; }
+				bool string(string_t& val) { if (item_value()) { _value.kind = Value::Kind::String; _value.p_string = &val; assign(); } return true; }
+				template<typename Binary> bool binary(Binary&) { return true; }
+
+				// Structure
+				bool start_object(std::size_t)
+				{
+					++_depth;
+					if (_depth == 3 && _section != Section::None) { _item = Item(); } // begin of item
+					return true;
+				}
+
+				bool end_object()
+				{
+					if (_depth == 3 && _section != Section::None) { finish_item(); } // end of item
+					--_depth;
+					return true;
+				}
+
+				bool start_array(std::size_t)
+				{
+					++_depth;
+					return true;
+				}
+
+				bool end_array()
+				{
+					--_depth;
+					return true;
+				}
+
+				bool key(string_t& val)
+				{
+					if (_depth == 1) // key in root object
+					{
+						_section = Section::None;
+						if (val == "Events") { _section = Section::Events; }
+						else if (val == "Layers") { _section = Section::Layers; }
+						else if (val == "Gaze") { _section = Section::Gaze; }
+						else if (val == "Infos") { _section = Section::Infos; }
+						else if (val == "States") { _section = Section::States; }
+						_seen_sections[(int)_section] = true;
+					}
+					else if (_depth == 3) // key in item
+					{
+						_field = to_field(val);
+					}
+					return true;
+				}
+
+				template<typename Exception>
+				bool parse_error(std::size_t, const std::string&, const Exception& ex)
+				{
+					_error = ex.what();
+					return false;
+				}
+
+				// Get error message, empty if none occurred
+				const std::string& get_error() const { return _error; }
+
+				// Get name of first section that is missing in the root object, empty if all sections are available
+				std::string get_missing_section() const
+				{
+					const char* names[] = { "", "Events", "Layers", "Gaze", "Infos", "States" };
+					for (int i = (int)Section::Events; i <= (int)Section::States; ++i)
+					{
+						if (!_seen_sections[i]) { return names[i]; }
+					}
+					return "";
+				}
+
+			private:
+
+				// Sections of the datacast
+				enum class Section { None, Events, Layers, Gaze, Infos, States };
+
+				// Fields of items
+				enum class Field { None, Type, QtVideoTs, QtVideoTsFirst, QtVideoTsLast, QtGlobalTs, ScrollY, X, Y, Width, Height, ZIndex, Xpath, LeftX, LeftY, VideoFramerate };
+
+				// Scalar value of a field
+				struct Value
+				{
+					enum class Kind { Null, Integer, Float, String };
+					Kind kind = Kind::Null;
+					core::long64 integer = 0;
+					double floating = 0.0;
+					const string_t* p_string = nullptr;
+
+					// Conversions like the ones of the json library
+					core::long64 as_long64() const { return kind == Kind::Float ? (core::long64)floating : integer; }
+					int as_int() const { return kind == Kind::Float ? (int)floating : (int)integer; }
+					float as_float() const { return kind == Kind::Float ? (float)floating : (float)integer; }
+				};
+
+				// Fields of the item that is currently read, union of all sections
+				struct Item
+				{
+					Datacast::Type type = Datacast::Type::Other;
+					core::long64 ms = 0, ms_first = 0, ms_last = 0;
+					int scroll_y = 0, x = 0, y = 0, width = 0, height = 0, zindex = 0;
+					float left_x = -1.f, left_y = -1.f;
+					bool left_x_valid = false, left_y_valid = false;
+					std::string xpath = "", global_ts = "", framerate = "";
+				};
+
+				// Whether the current value belongs to a field of an item
+				bool item_value() const
+				{
+					return _depth == 3 && _section != Section::None && _field != Field::None;
+				}
+
+				// Map key to field
+				static Field to_field(const string_t& key)
+				{
+					const char* k = key.c_str();
+					if (std::strcmp(k, "type") == 0) { return Field::Type; }
+					if (std::strcmp(k, "qtVideoTs") == 0) { return Field::QtVideoTs; }
+					if (std::strcmp(k, "x") == 0) { return Field::X; }
+					if (std::strcmp(k, "y") == 0) { return Field::Y; }
+					if (std::strcmp(k, "scrollY") == 0) { return Field::ScrollY; }
+					if (std::strcmp(k, "leftX") == 0) { return Field::LeftX; }
+					if (std::strcmp(k, "leftY") == 0) { return Field::LeftY; }
+					if (std::strcmp(k, "width") == 0) { return Field::Width; }
+					if (std::strcmp(k, "height") == 0) { return Field::Height; }
+					if (std::strcmp(k, "qtVideoTs_first") == 0) { return Field::QtVideoTsFirst; }
+					if (std::strcmp(k, "qtVideoTs_last") == 0) { return Field::QtVideoTsLast; }
+					if (std::strcmp(k, "xpath") == 0) { return Field::Xpath; }
+					if (std::strcmp(k, "z-index") == 0) { return Field::ZIndex; }
+					if (std::strcmp(k, "qtGlobalTs") == 0) { return Field::QtGlobalTs; }
+					if (std::strcmp(k, "videoFramerate") == 0) { return Field::VideoFramerate; }
+					return Field::None;
+				}
+
+				// Map type string to type of item
+				Datacast::Type to_type(const string_t& type) const
+				{
+					switch (_section)
+					{
+					case Section::Events:
+						if (type == "jsScroll") { return Datacast::Type::JsScroll; }
+						if (type == "webviewGeometry") { return Datacast::Type::WebviewGeometry; }
+						if (type == "move") { return Datacast::Type::Move; }
+						if (type == "click") { return Datacast::Type::Click; }
+						break;
+					case Section::Layers:
+						if (type == "fixed") { return Datacast::Type::Fixed; }
+						break;
+					case Section::Infos:
+						if (type == "videoStarted") { return Datacast::Type::VideoStarted; }
+						if (type == "videoEnded") { return Datacast::Type::VideoEnded; }
+						if (type == "meta") { return Datacast::Type::Meta; }
+						break;
+					case Section::States:
+						if (type == "documentIsHidden") { return Datacast::Type::DocumentIsHidden; }
+						break;
+					default:
+						break;
+					}
+					return Datacast::Type::Other;
+				}
+
+				// Assign value to field of current item
+				void assign()
+				{
+					const bool is_null = _value.kind == Value::Kind::Null;
+					const bool is_number = _value.kind == Value::Kind::Integer || _value.kind == Value::Kind::Float;
+					const bool is_string = _value.kind == Value::Kind::String;
+					switch (_field)
+					{
+					case Field::Type: if (is_string) { _item.type = to_type(*_value.p_string); } break;
+					case Field::QtVideoTs: if (is_number) { _item.ms = _value.as_long64(); } break;
+					case Field::QtVideoTsFirst: if (is_number) { _item.ms_first = _value.as_long64(); } break;
+					case Field::QtVideoTsLast: if (is_number) { _item.ms_last = _value.as_long64(); } break;
+					case Field::QtGlobalTs: if (is_string) { _item.global_ts = *_value.p_string; } break;
+					case Field::ScrollY: if (is_number) { _item.scroll_y = _value.as_int(); } break;
+					case Field::X: if (is_number) { _item.x = _value.as_int(); } break;
+					case Field::Y: if (is_number) { _item.y = _value.as_int(); } break;
+					case Field::Width: if (is_number) { _item.width = _value.as_int(); } break;
+					case Field::Height: if (is_number) { _item.height = _value.as_int(); } break;
+					case Field::ZIndex: if (is_number) { _item.zindex = _value.as_int(); } break;
+					case Field::Xpath: if (is_string) { _item.xpath = *_value.p_string; } break;
+					case Field::LeftX: _item.left_x_valid = !is_null; if (is_number) { _item.left_x = _value.as_float(); } break;
+					case Field::LeftY: _item.left_y_valid = !is_null; if (is_number) { _item.left_y = _value.as_float(); } break;
+					case Field::VideoFramerate: if (is_string) { _item.framerate = *_value.p_string; } break;
+					default: break;
+					}
+					_field = Field::None;
+				}
+
+				// Store current item in the datacast
+				void finish_item()
+				{
+					switch (_section)
+					{
+					case Section::Events:
+					{
+						Datacast::Event event;
+						event.ms = _item.ms;
+						event.type = _item.type;
+						event.scroll_y = _item.scroll_y;
+						event.x = _item.x;
+						event.y = _item.y;
+						event.width = _item.width;
+						event.height = _item.height;
+						_r_datacast.events.push_back(event);
+					} break;
+					case Section::Layers:
+					{
+						Datacast::Layer layer;
+						layer.ms_first = _item.ms_first;
+						layer.ms_last = _item.ms_last;
+						layer.type = _item.type;
+						layer.xpath = std::move(_item.xpath);
+						layer.x = _item.x;
+						layer.y = _item.y;
+						layer.width = _item.width;
+						layer.height = _item.height;
+						layer.zindex = _item.zindex;
+						_r_datacast.layers.push_back(std::move(layer));
+					} break;
+					case Section::Gaze:
+					{
+						Datacast::Gaze gaze;
+						gaze.ms = _item.ms;
+						gaze.x = _item.left_x_valid ? _item.left_x : -1.f;
+						gaze.y = _item.left_y_valid ? _item.left_y : -1.f;
+						gaze.valid = _item.left_x_valid && _item.left_y_valid;
+						_r_datacast.gaze.push_back(gaze);
+					} break;
+					case Section::Infos:
+					{
+						switch (_item.type)
+						{
+						case Datacast::Type::VideoStarted: _r_datacast.video_started_ms = std::stoll(_item.global_ts); break;
+						case Datacast::Type::VideoEnded: _r_datacast.video_ended_ms = std::stoll(_item.global_ts); break;
+						case Datacast::Type::Meta: _r_datacast.video_framerate = std::stoi(_item.framerate); break;
+						default: break;
+						}
+					} break;
+					case Section::States:
+					{
+						if (_item.type == Datacast::Type::DocumentIsHidden)
+						{
+							_r_datacast.document_hidden_ms.push_back(_item.ms);
+						}
+					} break;
+					default:
+						break;
+					}
+				}
+
+				// Members
+				Datacast& _r_datacast;
+				int _depth = 0; // depth of nesting, root object is at depth one
+				Section _section = Section::None;
+				Field _field = Field::None;
+				Value _value;
+				Item _item;
+				std::string _error = "";
+				bool _seen_sections[6] = { false, false, false, false, false, false }; // indexed by section
+			};
+
+			Datacast::Datacast(std::string json_path)
+			{
+				// Open datacast
+				std::ifstream json_file(json_path);
+				if (!json_file.is_open())
+				{
+					throw std::runtime_error("Datacast could not be opened: " + json_path);
+				}
+
+				// Stream datacast through handler
+				DatacastHandler handler(*this);
+				if (!nlohmann::json::sax_parse(json_file, &handler))
+				{
+					throw std::runtime_error("Datacast could not be parsed: " + json_path + " " + handler.get_error());
+				}
+				std::string missing_section = handler.get_missing_section();
+				if (!missing_section.empty())
+				{
+					throw std::runtime_error("Datacast has no section " + missing_section + ": " + json_path);
+				}
+			}
+		}
+	}
+}
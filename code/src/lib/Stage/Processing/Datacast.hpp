@@ -0,0 +1,77 @@
+//! Datacast.
+/*!
+Compact, typed content of a datacast as required by the parser. Streams the .json file through a SAX handler,
+thus the complete document is never held in memory and only values of interest are stored.
+*/
+
+#pragma once
+
+#include <Core/Core.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace stage
+{
+	namespace processing
+	{
+		namespace parser
+		{
+			// Datacast of a log record
+			class Datacast
+			{
+			public:
+
+				// Type of an item in the datacast
+				enum class Type : char { Other, JsScroll, WebviewGeometry, Move, Click, Fixed, VideoStarted, VideoEnded, Meta, DocumentIsHidden };
+
+				// Item of "Events", which includes mouse input
+				struct Event
+				{
+					core::long64 ms = 0; // qtVideoTs
+					Type type = Type::Other;
+					int scroll_y = 0;
+					int x = 0;
+					int y = 0;
+					int width = 0;
+					int height = 0;
+				};
+
+				// Item of "Layers"
+				struct Layer
+				{
+					core::long64 ms_first = 0; // qtVideoTs_first
+					core::long64 ms_last = 0; // qtVideoTs_last
+					Type type = Type::Other;
+					std::string xpath = "";
+					int x = 0;
+					int y = 0;
+					int width = 0;
+					int height = 0;
+					int zindex = 0;
+				};
+
+				// Item of "Gaze"
+				struct Gaze
+				{
+					core::long64 ms = 0; // qtVideoTs
+					float x = -1.f; // leftX
+					float y = -1.f; // leftY
+					bool valid = true; // false if x or y is null
+				};
+
+				// Constructor, reads the datacast from the .json file. Throws if the file cannot be opened or parsed or lacks a section
+				Datacast(std::string json_path);
+
+				// Members
+				std::vector<Event> events;
+				std::vector<Layer> layers;
+				std::vector<Gaze> gaze;
+				std::vector<core::long64> document_hidden_ms; // qtVideoTs of "documentIsHidden" items in "States"
+				core::long64 video_started_ms = 0; // qtGlobalTs of "videoStarted" item in "Infos"
+				core::long64 video_ended_ms = 0; // qtGlobalTs of "videoEnded" item in "Infos"
+				int video_framerate = 0; // videoFramerate of "meta" item in "Infos", zero if not available
+			};
+		}
+	}
+}
@@ -4,6 +4,8 @@
 #include <libsimplewebm.hpp>
 #include <fstream>
 #include <deque>
+#include <map>
+#include <algorithm>
 
 const float TIME_BIAS_DATACAST = core::mt::get_config_value(0.0f, { "processing", "parser", "time_bias_datacast" });
 
@@ -20,17 +22,11 @@ namespace stage
 				std::shared_ptr<const data::Session> sp_session)
 				:
 				Interface(VD(sp_dump, ) sp_session->get_id()),
+				_datacast(sp_session->get_json_path()), // stream datacast into compact structures
 				_webm_path(sp_session->get_webm_path())
 			{
-				// Open datacast
-				std::ifstream json_file(sp_session->get_json_path()); // TODO: check whether file exists and return error if not
-				json_file >> _datacast;
-
-				// Open screencast
-				auto up_dry_video_walker = simplewebm::create_video_walker(_webm_path);
-
-				// Perform a dry walk on the complete video to gather times
-				up_dry_video_walker->dry_walk(_sp_times, 0); // TODO: check status
+				// Gather times of screencast (from sidecar index or by a dry walk on the complete video)
+				_sp_times = sp_session->get_frame_cache()->get_frame_times();
 				_frame_count = (unsigned int)_sp_times->size();
 				int frame_limit = sp_session->get_frame_limit();
 				if (frame_limit >= 0)
@@ -38,56 +34,25 @@ namespace stage
 					_frame_count = std::min(_frame_count, (unsigned int)frame_limit);
 				}
 
-				// Prepare events phase
-				_events = _datacast.at("Events"); // TODO: check for exception
-				_it_events = _events.begin(); // might be already end() if empty
-
-				// Prepare layers phase
-				_layers = _datacast.at("Layers"); // TODO: check for exception
-				_it_layers = _layers.begin(); // might be already end() if empty
-
-				// Prepare input phase (mouse data also stored under events in .json)
-				_mouse = _datacast.at("Events"); // TODO: check for exception
-				_it_mouse = _mouse.begin(); // might be already end() if empty
-				_gaze = _datacast.at("Gaze");
-				_it_gaze = _gaze.begin();
+				// Index times of frames in milliseconds, so frames covered by a layer are found by binary search
+				_frame_times_ms.reserve(_frame_count);
+				for (unsigned int frame_idx = 0; frame_idx < _frame_count; ++frame_idx)
+				{
+					double time = _sp_times->at(frame_idx);
+					time += TIME_BIAS_DATACAST;
+					_frame_times_ms.push_back(core::long64(time * 1000.0));
+				}
+				_frame_times_sorted = std::is_sorted(_frame_times_ms.begin(), _frame_times_ms.end());
 
 				// Retrieve duration of datacast and duration of one frame
-				core::long64 startMS = 0, endMS = 0;
-				for(auto& r_item : _datacast.at("Infos"))
+				core::long64 startMS = _datacast.video_started_ms, endMS = _datacast.video_ended_ms;
+				if (_datacast.video_framerate > 0)
 				{
-					std::string type = r_item.at("type");
-					if(type == "videoStarted")
-					{
-						std::string ts_string = r_item["qtGlobalTs"].get<std::string>();
-						startMS = std::stoll(ts_string);
-					}
-					else if(type == "videoEnded")
-					{
-						std::string ts_string = r_item["qtGlobalTs"].get<std::string>();
-						endMS = std::stoll(ts_string);
-					}
-					else if(type == "meta")
-					{
-						std::string rate_string = r_item["videoFramerate"].get<std::string>();
-						int rate = std::stoi(rate_string);
-						_frame_duration = 1000 / rate;
-						
-					}
+					_frame_duration = 1000 / _datacast.video_framerate;
 				}
 
 				// Get times where the document changes (is hidden)
-				auto states = _datacast.at("States");
-				auto it_states = states.begin();
-				while(it_states != states.end())
-				{
-					auto event = it_states.value();
-					if (event["type"].get<std::string>() == "documentIsHidden")
-					{
-						document_change_times_ms.push_back(event["qtVideoTs"].get<core::long64>());
-					}
-					++it_states;
-				}
+				document_change_times_ms = _datacast.document_hidden_ms;
 
 				// Create product
 				_sp_container = std::shared_ptr<ProductType>(new ProductType(sp_session, ((double)(endMS-startMS)) / 1000.0));
@@ -113,23 +78,23 @@ namespace stage
 						// Before returning the product, fill the visual debug dump
 						VD(if (_sp_dump) {
 
-							// Walk over video in parallel and store the screenshots for nice visual debugging
-							auto up_video_walker = simplewebm::create_video_walker(_webm_path);
+							// Fetch screenshots from the frame cache of the session for nice visual debugging
+							auto sp_frame_cache = _sp_container->get_session()->get_frame_cache();
 
 							// Go over log dates and push visual debug dates into the dump
+							unsigned int frame_idx = 0;
 							for (const auto& r_log_datum : *_sp_container->get().get())
 							{
 								// Extract screenshot
-								auto sp_images = std::shared_ptr<std::vector<simplewebm::Image> >(new std::vector<simplewebm::Image>);
-								up_video_walker->walk(sp_images, 1); // TODO: check status
+								auto sp_image = sp_frame_cache->get(frame_idx++);
 								cv::Mat screen_pixels;
-								if (!sp_images->empty())
+								if (sp_image)
 								{
 									screen_pixels = cv::Mat(
-										sp_images->at(0).height,
-										sp_images->at(0).width,
+										sp_image->height,
+										sp_image->width,
 										CV_8UC3,
-										const_cast<char *>(sp_images->at(0).data.data()));
+										const_cast<char *>(sp_image->data.data())).clone(); // cache might forget the frame
 								}
 
 								// Add visual debug datum of log datum and apppend corresponding screenshot
@@ -155,10 +120,10 @@ namespace stage
 				{
 				case Phase::Events:
 				{
-					float size = (float)_events.size();
+					float size = (float)_datacast.events.size();
 					if (size > 0.f)
 					{
-						r_report.set_progress(((float)(_it_events - _events.begin()) / size) * 0.5f);
+						r_report.set_progress(((float)_events_idx / size) * 0.5f);
 					}
 					else
 					{
@@ -167,10 +132,10 @@ namespace stage
 				} break;
 				case Phase::Layers:
 				{
-					float size = (float)_layers.size();
+					float size = (float)_datacast.layers.size();
 					if (size > 0.f)
 					{
-						r_report.set_progress((((float)(_it_layers - _layers.begin()) / size) * 0.5f) + 0.5f);
+						r_report.set_progress((((float)_layers_idx / size) * 0.5f) + 0.5f);
 					}
 					else
 					{
@@ -201,25 +166,22 @@ namespace stage
 						sp_log_datum = std::shared_ptr<data::LogDatum>(new data::LogDatum(time));
 
 						// Parse for values that should be const over the complete time but still stored with timestamp
-						auto tmp_it = _datacast.at("Events").begin();
-						while (tmp_it != _datacast.at("Events").end())
+						for (const auto& r_event : _datacast.events)
 						{
-							auto event = tmp_it.value();
-							if (event["type"].get<std::string>() == "webviewGeometry")
+							if (r_event.type == Datacast::Type::WebviewGeometry)
 							{
-								sp_log_datum->set_viewport_width(event["width"].get<int>());
-								sp_log_datum->set_viewport_height(event["height"].get<int>());
+								sp_log_datum->set_viewport_width(r_event.width);
+								sp_log_datum->set_viewport_height(r_event.height);
 								sp_log_datum->set_viewport_on_screen_position(
-									cv::Point2i(event["x"].get<int>(), event["y"].get<int>()));
+									cv::Point2i(r_event.x, r_event.y));
 								break; // break after first occurence (if it will be looked for multiple values here, use bool instead)
 							}
-							++tmp_it;
 						}
 						sp_log_datum->set_viewport_pos(cv::Point2i(0, 0)); // as of now, screencast only contains viewport, no more desktop recording
 					}
-					else // deep copy of previous log datum
+					else // copy of previous log datum (layers are shared until modified)
 					{
-						sp_log_datum = _sp_container->get()->at(_events_frame_idx - 1)->deep_copy(time);
+						sp_log_datum = _sp_container->get()->at(_events_frame_idx - 1)->copy(time);
 					}
 
 					// Check for document change (in order to reset scrolling at page change)
@@ -241,11 +203,11 @@ namespace stage
 
 					// Go through datacast until the end time of the frame to accomondate for incoming events
 					bool until_time = true;
-					while (until_time && _it_events != _events.end())
+					while (until_time && _events_idx < _datacast.events.size())
 					{
 						// Retrieve event from datacast and its time within in the screencast
-						auto event = _it_events.value();
-						core::long64 ms = event["qtVideoTs"].get<core::long64>(); // fallback: timestamp from Qt
+						const auto& r_event = _datacast.events.at(_events_idx);
+						core::long64 ms = r_event.ms; // fallback: timestamp from Qt
 
 						/*
 						auto it_js_ms = event.find("jsVideoTs");
@@ -258,23 +220,22 @@ namespace stage
 						// Check whether event is still within time of frame
 						if (ms <= (core::long64)(time * 1000.0))
 						{
-							std::string type = event["type"].get<std::string>();
-							if (type == "jsScroll") // scrolling
+							if (r_event.type == Datacast::Type::JsScroll) // scrolling
 							{
-								sp_log_datum->get_root()->set_scroll_y(event["scrollY"].get<int>());
+								sp_log_datum->get_root()->set_scroll_y(r_event.scroll_y);
 							}
-							else if (type == "webviewGeometry") // webview geometry update (should not happen)
+							else if (r_event.type == Datacast::Type::WebviewGeometry) // webview geometry update (should not happen)
 							{
-								sp_log_datum->set_viewport_width(event["width"].get<int>());
-								sp_log_datum->set_viewport_height(event["height"].get<int>());
+								sp_log_datum->set_viewport_width(r_event.width);
+								sp_log_datum->set_viewport_height(r_event.height);
 								sp_log_datum->set_viewport_on_screen_position(
-									cv::Point2i(event["x"].get<int>(), event["y"].get<int>()));
+									cv::Point2i(r_event.x, r_event.y));
 							}
 
 							// TODO: overflow scrolling, maybe later video play and pause? -> need layer structures which are parsed after the events -> "layer_events" as extra step?
 
 							// Next event in datacast
-							++_it_events;
+							++_events_idx;
 						}
 						else
 						{
@@ -297,12 +258,12 @@ namespace stage
 			bool LogRecord::parse_layers()
 			{
 				// Check for sanity of iterator (never enters if container is empty)
-				if (_it_layers != _layers.end())
+				if (_layers_idx < _datacast.layers.size())
 				{
-					// Times of layer the iterator points at
-					auto layer = _it_layers.value();
-					core::long64 ms_start = layer["qtVideoTs_first"].get<core::long64>();
-					core::long64 ms_end = layer["qtVideoTs_last"].get<core::long64>();
+					// Times of layer the index points at
+					const auto& r_layer = _datacast.layers.at(_layers_idx);
+					core::long64 ms_start = r_layer.ms_first;
+					core::long64 ms_end = r_layer.ms_last;
 
 					// Hotfix for start that is reported slightly later than the layer was actually visible)
 					if (ms_start < (core::long64)(1000.0 * TIME_BIAS_DATACAST))
@@ -311,7 +272,7 @@ namespace stage
 					}
 
 					// Get xpath
-					std::string xpath = layer["xpath"].get<std::string>();
+					const std::string& xpath = r_layer.xpath;
 					
 					// Filter certain xpaths (this is adapted to the dataset, please think at least about external file with those definitions)
 					bool proceed = true;
@@ -326,60 +287,73 @@ namespace stage
 					if (proceed)
 					{
 						// Check type of layer
-						std::string type = layer["type"].get<std::string>();
-						if (type == "fixed")
+						if (r_layer.type == Datacast::Type::Fixed)
 						{
 							// Fixed elements are already in viewport pixel space
-							int view_x = layer["x"].get<int>();
-							int view_y = layer["y"].get<int>();
-							int view_width = layer["width"].get<int>();
-							int view_height = layer["height"].get<int>();
-							int zindex = layer["z-index"].get<int>();
-
-							// Go over log dates and append layers
+							int view_x = r_layer.x;
+							int view_y = r_layer.y;
+							int view_width = r_layer.width;
+							int view_height = r_layer.height;
+							int zindex = r_layer.zindex;
+
+							// Layers are shared among log dates with the same viewport size
+							std::map<std::pair<int, int>, std::shared_ptr<data::Layer> > shared_layers;
+
+							// Find range of frames within occurence of layer (assume frame covers some time window)
+							core::long64 frame_window_offset = (core::long64) (0.125 * _frame_duration);
+							core::long64 ms_lower = ms_start - frame_window_offset;
+							core::long64 ms_upper = ms_end + frame_window_offset;
 							unsigned int frame_idx = 0;
-							while (frame_idx < _frame_count)
+							unsigned int frame_end = _frame_count;
+							if (_frame_times_sorted)
 							{
-								// Read time of frame in screencast (seconds)
-								double time = _sp_times->at(frame_idx);
-								time += TIME_BIAS_DATACAST;
-								core::long64 time_ms = core::long64(time * 1000.0);
+								frame_idx = (unsigned int)(std::upper_bound(_frame_times_ms.begin(), _frame_times_ms.end(), ms_lower) - _frame_times_ms.begin());
+								frame_end = (unsigned int)(std::lower_bound(_frame_times_ms.begin(), _frame_times_ms.end(), ms_upper) - _frame_times_ms.begin());
+							}
+
+							// Go over log dates in that range and append layers
+							for (; frame_idx < frame_end; ++frame_idx)
+							{
+								// Check whether time is within occurence of layer (only relevant when frame times are not sorted)
+								core::long64 time_ms = _frame_times_ms.at(frame_idx);
+								if (time_ms <= ms_lower || time_ms >= ms_upper)
+								{
+									continue;
+								}
 
 								// Get reference to log datum
 								auto sp_log_datum = _sp_container->get()->at(frame_idx); // TODO: would be more elegant to use frame time in log datum
 
-								// Check whether time is within occurence of layer
-								core::long64 frame_window_offset = (core::long64) (0.125 * _frame_duration); // assume frame covers some time window
-								if (time_ms > (ms_start - frame_window_offset) && time_ms < (ms_end + frame_window_offset))
+								// Check that layer does not yet exist (overlapping times in datacast might cause layer to be added twice in same log record)
+								// auto root = sp_log_datum->get_root();
+								// std::deque<std::shared_ptr<const Layer> > layers_to_check;
+								// TODO Use layer comparator etc.
+
+								// Create layer or reuse the one of a log datum with the same viewport size
+								auto& rsp_layer = shared_layers[std::make_pair(sp_log_datum->get_viewport_width(), sp_log_datum->get_viewport_height())];
+								if (!rsp_layer)
 								{
-									// Check that layer does not yet exist (overlapping times in datacast might cause layer to be added twice in same log record)
-									// auto root = sp_log_datum->get_root();
-									// std::deque<std::shared_ptr<const Layer> > layers_to_check;
-									// TODO Use layer comparator etc.
-
-									// Append layer to root of that log datum
-									auto _sp_layer = data::Layer::create();
-									_sp_layer->set_type(data::LayerType::Fixed);
-									_sp_layer->set_xpath(xpath);
-									_sp_layer->set_view_pos(cv::Point2i(view_x, view_y));
-									_sp_layer->set_view_width(view_width);
-									_sp_layer->set_view_height(view_height);
-									_sp_layer->set_zindex(zindex);
-									sp_log_datum->get_root()->append_child(_sp_layer);
+									rsp_layer = data::Layer::create();
+									rsp_layer->set_type(data::LayerType::Fixed);
+									rsp_layer->set_xpath(xpath);
+									rsp_layer->set_view_pos(cv::Point2i(view_x, view_y));
+									rsp_layer->set_view_width(view_width);
+									rsp_layer->set_view_height(view_height);
+									rsp_layer->set_zindex(zindex);
 								}
 
-								// Increase index of frame
-								++frame_idx;
+								// Append layer to root of that log datum
+								sp_log_datum->get_root()->append_child(rsp_layer);
 							}
 						} // TODO introduce more types of layers
 					}
 
 					// Next layer in datacast
-					++_it_layers;
+					++_layers_idx;
 				}
 
 				// Return true when all fixed elements have been handled
-				return _it_layers == _layers.end();
+				return _layers_idx >= _datacast.layers.size();
 			}
 
 			bool LogRecord::parse_input()
@@ -398,11 +372,11 @@ namespace stage
 					
 					// Go through mouse data until the end time of the frame
 					bool until_time = true;
-					while (until_time && _it_mouse != _mouse.end())
+					while (until_time && _mouse_idx < _datacast.events.size())
 					{
 						// Retrieve mouse input from datacast and its time within in the screencast
-						auto mouse = _it_mouse.value();
-						core::long64 ms = mouse["qtVideoTs"].get<core::long64>(); // fallback: timestamp from Qt
+						const auto& r_mouse = _datacast.events.at(_mouse_idx);
+						core::long64 ms = r_mouse.ms; // fallback: timestamp from Qt
 
 						/*
 						auto it_js_ms = event.find("jsVideoTs");
@@ -415,19 +389,18 @@ namespace stage
 						// Check whether event is still within time of frame
 						if (ms <= (core::long64)(time * 1000.0))
 						{
-							std::string type = mouse["type"].get<std::string>();
-							if (type == "move") // cursor movement
+							if (r_mouse.type == Datacast::Type::Move) // cursor movement
 							{
-								inputs.push_back(std::make_shared<data::MoveInput>(ms, mouse["x"].get<int>(), mouse["y"].get<int>()));
+								inputs.push_back(std::make_shared<data::MoveInput>(ms, r_mouse.x, r_mouse.y));
 							}
-							else if (type == "click") // cursor click
+							else if (r_mouse.type == Datacast::Type::Click) // cursor click
 							{
-								inputs.push_back(std::make_shared<data::ClickInput>(ms, mouse["x"].get<int>(), mouse["y"].get<int>()));
+								inputs.push_back(std::make_shared<data::ClickInput>(ms, r_mouse.x, r_mouse.y));
 							}
 							// Ignore items with other type
 
 							// Next item in datacast
-							++_it_mouse;
+							++_mouse_idx;
 						}
 						else
 						{
@@ -438,35 +411,20 @@ namespace stage
 
 					// Go through gaze data until the end time of the frame
 					until_time = true;
-					while (until_time && _it_gaze != _gaze.end())
+					while (until_time && _gaze_idx < _datacast.gaze.size())
 					{
 						// Retrieve gaze sample from datacast and its time within in the screencast
-						auto gaze = _it_gaze.value();
-						core::long64 ms = gaze["qtVideoTs"].get<core::long64>();
+						const auto& r_gaze = _datacast.gaze.at(_gaze_idx);
+						core::long64 ms = r_gaze.ms;
 
 						// Check whether event is still within time of frame
 						if (ms <= (core::long64)(time * 1000.0))
 						{
-							// Extract gaze sample
-							bool valid = true;
-							float x = -1.0;
-							float y = -1.0;
-							if (!(gaze["leftX"].is_null()))
-							{
-								x = gaze["leftX"].get<float>();
-							}
-							else { valid = false; }
-							if (!(gaze["leftY"].is_null()))
-							{
-								y = gaze["leftY"].get<float>();
-							}
-							else { valid = false; }
-
 							// Push back
-							inputs.push_back(std::make_shared<data::GazeInput>(ms, (int)x, (int)y, valid));
+							inputs.push_back(std::make_shared<data::GazeInput>(ms, (int)r_gaze.x, (int)r_gaze.y, r_gaze.valid));
 							
 							// Next item in datacast
-							++_it_gaze;
+							++_gaze_idx;
 						}
 						else
 						{
@@ -475,52 +433,67 @@ namespace stage
 						}
 					}
 
-					// Put collected inputs into corresponding layers
-					std::deque<std::shared_ptr<data::Layer> > queue;
-					queue.push_back(sp_log_datum->get_root());
-					while (!queue.empty())
+					// Put each collected input into the top-most layer whose mask contains it. Layers are painted in order of their z-index
+					// and in document order for equal z-index, i.e., descendants and later siblings are on top. Walk over read-only layers
+					// in document order and only modify the layers that receive input, so layers without input stay shared among log dates
+					std::shared_ptr<const data::LogDatum> sp_const_log_datum = sp_log_datum;
+					std::vector<bool> hits(inputs.size(), false); // whether input is in any layer
+					std::vector<int> hit_zindices(inputs.size(), 0); // z-index of top-most layer per input
+					std::vector<std::vector<unsigned int> > hit_accesses(inputs.size()); // access to top-most layer per input
+					std::vector<std::pair<std::vector<unsigned int>, std::shared_ptr<const data::Layer> > > stack;
+					stack.push_back(std::make_pair(std::vector<unsigned int>(), sp_const_log_datum->get_root()));
+					while (!inputs.empty() && !stack.empty()) // nothing to walk when there is no input
 					{
 						// Get next layer
-						auto sp_layer = queue.front();
-						queue.pop_front();
-
-						// Add children of that layer to the queue
-						auto children = sp_layer->get_children();
-						for (auto& rsp_child : children)
+						auto entry = stack.back();
+						stack.pop_back();
+						const auto& r_access = entry.first;
+						const auto& sp_layer = entry.second;
+
+						// Add children of that layer to the stack, last child first so the first child is walked next
+						auto child_count = sp_layer->get_child_count();
+						for (unsigned int child_idx = child_count; child_idx > 0; --child_idx)
 						{
-							queue.push_back(rsp_child);
+							auto child_access = r_access;
+							child_access.push_back(child_idx - 1);
+							stack.push_back(std::make_pair(child_access, sp_layer->get_child(child_idx - 1)));
 						}
 
-						// Check whether coordinate is in the white part of the layers mask
-						auto mask = sp_layer->get_view_mask();
-
 						// Go over collected inputs
-						for (auto sp_input : inputs)
+						for (unsigned int input_idx = 0; input_idx < (unsigned int)inputs.size(); ++input_idx)
 						{
 							// Get coordinate in viewport x and y
-							int view_x = sp_input->get_view_x();
-							int view_y = sp_input->get_view_y();
+							int view_x = inputs.at(input_idx)->get_view_x();
+							int view_y = inputs.at(input_idx)->get_view_y();
 
 							// Check whether coordinate is within viewport
 							if (view_x < 0 || view_y < 0 || view_x >= sp_log_datum->get_viewport_width() || view_y >= sp_log_datum->get_viewport_height())
 							{
 								continue; // throw away input (TODO: or add to root?)
 							}
-			
-							// Check whether coordinate is on layer
-							auto value = mask.at<uchar>(
-								view_y,
-								view_x);
 
-							// Decide whether to add input to layer
-							if (value > 0) // TODO: might be increased, but as of now, mask entries are anyway either 0 or 255
+							// Layer is on top of the previous hit if its z-index is not lower, as it comes later in document order
+							if (hits.at(input_idx) && sp_layer->get_zindex() < hit_zindices.at(input_idx)) { continue; }
+			
+							// Decide whether layer receives input, i.e., whether coordinate is in the white part of the layers mask
+							if (sp_layer->is_in_view_mask(view_x, view_y))
 							{
-								// Push back input into layer (if masks are not disjunct, input is put into multiple layers
-								sp_layer->push_back_input(sp_input); // multiple layers might point to the SAME input object...
+								hits.at(input_idx) = true;
+								hit_zindices.at(input_idx) = sp_layer->get_zindex();
+								hit_accesses.at(input_idx) = r_access;
 							}
 						}
 					}
 
+					// Push back inputs into their layers
+					for (unsigned int input_idx = 0; input_idx < (unsigned int)inputs.size(); ++input_idx)
+					{
+						if (hits.at(input_idx))
+						{
+							sp_log_datum->access_layer(hit_accesses.at(input_idx))->push_back_input(inputs.at(input_idx)); // copies shared layers on the path
+						}
+					}
+
 					// Increase index of frame
 					++frame_idx;
 				}
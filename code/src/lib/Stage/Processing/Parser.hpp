@@ -12,13 +12,11 @@ Interface for multi-threaded parsers that provide log dates. Implementation of i
 
 #include <Core/Task.hpp>
 #include <Data/LogDatum.hpp>
-#include <nlohmann/json.hpp>
+#include <Stage/Processing/Datacast.hpp>
 #include <opencv2/core/types.hpp>
 #include <memory>
 #include <vector>
 
-using json = nlohmann::json;
-
 namespace stage
 {
 	namespace processing
@@ -95,27 +93,25 @@ namespace stage
 				std::shared_ptr<ProductType> _sp_container;
 
 				// Data of log record in memory for parsing
-				json _datacast;
-				std::shared_ptr<std::vector<double> > _sp_times = std::shared_ptr<std::vector<double> >(new std::vector<double>); // required info from screencast
+				Datacast _datacast;
+				std::shared_ptr<const std::vector<double> > _sp_times = nullptr; // required info from screencast
 				unsigned int _frame_count = 0;
+				std::vector<core::long64> _frame_times_ms; // times of frames including datacast bias, index for lookup of frame ranges
+				bool _frame_times_sorted = true; // whether binary search on frame times is possible
 
 				// Internal phase of the parser (for the stepwise execution)
 				Phase _phase = Phase::Events; // events are parsed in log records, layers are then integrated to these structures
 
 				// Events phase
-				json _events;
-				json::iterator _it_events; // go over events, framewise
+				std::size_t _events_idx = 0; // go over events, framewise
 				unsigned int _events_frame_idx = 0;
 
 				// Layers phase
-				json _layers;
-				json::iterator _it_layers;
-
-				// Input phase
-				json _mouse;
-				json::iterator _it_mouse;
-				json _gaze;
-				json::iterator _it_gaze;
+				std::size_t _layers_idx = 0;
+
+				// Input phase (mouse data also stored under events in datacast)
+				std::size_t _mouse_idx = 0;
+				std::size_t _gaze_idx = 0;
 
 				// Other
 				std::string _webm_path;
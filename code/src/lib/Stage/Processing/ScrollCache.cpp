@@ -0,0 +1,149 @@
+#include "ScrollCache.hpp"
+#include <Stage/Processing/Snapshot.hpp>
+#include <Core/Core.hpp>
+#include <experimental/filesystem>
+#include <fstream>
+#include <cstring>
+
+namespace fs = std::experimental::filesystem;
+
+const bool SCROLL_CACHE = core::mt::get_config_value(true, { "processing", "tuning", "scroll_cache", "enable" });
+const std::string SCROLL_CACHE_DIRECTORY = core::mt::get_config_value(std::string(""), { "processing", "tuning", "scroll_cache", "directory" });
+
+// Format of scroll cache
+const std::string SCROLL_CACHE_SUFFIX = ".scroll_cache";
+const char SCROLL_CACHE_MAGIC[4] = { 'G', 'M', 'S', 'C' };
+const std::uint32_t SCROLL_CACHE_VERSION = 1;
+
+namespace stage
+{
+	namespace processing
+	{
+		namespace scroll_cache
+		{
+			// Path to scroll cache of session
+			static std::string scroll_cache_path(const data::Session& r_session)
+			{
+				if (SCROLL_CACHE_DIRECTORY.empty())
+				{
+					return r_session.get_json_path() + SCROLL_CACHE_SUFFIX; // next to datacast
+				}
+				return (fs::path(SCROLL_CACHE_DIRECTORY) / (fs::path(r_session.get_json_path()).filename().string() + SCROLL_CACHE_SUFFIX)).string();
+			}
+
+			// Read value from stream, returns false if stream ended
+			template<typename T>
+			static bool read(std::istream& r_in, T& r_value)
+			{
+				r_in.read(reinterpret_cast<char*>(&r_value), sizeof(T));
+				return r_in.good();
+			}
+
+			// Write value into stream
+			template<typename T>
+			static void write(std::ostream& r_out, T value)
+			{
+				r_out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+			}
+
+			bool compute_key(const data::Session& r_session, std::uint64_t& r_key)
+			{
+				if (!SCROLL_CACHE) { return false; }
+				return snapshot::compute_key(r_session, r_key); // depends on the same input and config as the snapshot
+			}
+
+			std::shared_ptr<data::LogDatumContainer> load(std::shared_ptr<const data::LogDatumContainer> sp_parsed_container, std::uint64_t key)
+			{
+				std::ifstream in(scroll_cache_path(*sp_parsed_container->get_session().get()), std::ios::binary);
+				if (!in.is_open()) { return nullptr; }
+
+				// Compare header
+				char magic[4];
+				std::uint32_t version = 0;
+				std::uint64_t cache_key = 0, frame_count = 0;
+				in.read(magic, sizeof(magic));
+				if (!in.good()
+					|| std::memcmp(magic, SCROLL_CACHE_MAGIC, sizeof(magic)) != 0
+					|| !read(in, version) || version != SCROLL_CACHE_VERSION
+					|| !read(in, cache_key) || cache_key != key
+					|| !read(in, frame_count) || frame_count != sp_parsed_container->get()->size())
+				{
+					return nullptr;
+				}
+
+				// Copy log dates and tune the layers whose cached scrolling differs (layers are only copied when tuned)
+				auto sp_arena = sp_parsed_container->get_layer_arena();
+				auto sp_container = std::make_shared<data::LogDatumContainer>(sp_parsed_container->get_session(), sp_parsed_container->get_datacast_duration());
+				for (unsigned int frame_idx = 0; frame_idx < (unsigned int)frame_count; ++frame_idx)
+				{
+					const auto& r_layer_packs = sp_arena->get_layer_packs(frame_idx);
+					std::uint32_t layer_count = 0;
+					if (!read(in, layer_count) || layer_count != r_layer_packs.size()) { return nullptr; } // layer trees do not fit
+					auto up_log_datum = sp_parsed_container->get()->at(frame_idx)->copy();
+					for (const auto& r_pack : r_layer_packs)
+					{
+						std::int32_t scroll_x = 0, scroll_y = 0;
+						if (!read(in, scroll_x) || !read(in, scroll_y)) { return nullptr; }
+						if (scroll_x != r_pack.sptr->get_scroll_x() || scroll_y != r_pack.sptr->get_scroll_y())
+						{
+							auto sp_tuned_layer = up_log_datum->access_layer(r_pack.access);
+							sp_tuned_layer->set_scroll_x(scroll_x);
+							sp_tuned_layer->set_scroll_y(scroll_y);
+						}
+					}
+					sp_container->push_back(std::move(up_log_datum));
+				}
+				return sp_container;
+			}
+
+			void store(const data::LogDatumContainer& r_tuned_container, std::uint64_t key)
+			{
+				// Write into temporary file first, so concurrent runs never read a partial cache
+				const std::string path = scroll_cache_path(*r_tuned_container.get_session().get());
+				const std::string tmp_path = core::misc::unique_tmp_path(path);
+				if (!SCROLL_CACHE_DIRECTORY.empty())
+				{
+					core::misc::create_directories(SCROLL_CACHE_DIRECTORY);
+				}
+				bool written = false;
+				{
+					std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+					if (!out.is_open())
+					{
+						core::mt::log_warn("Scroll cache cannot be written: ", path);
+						return;
+					}
+
+					// Header
+					out.write(SCROLL_CACHE_MAGIC, sizeof(SCROLL_CACHE_MAGIC));
+					write<std::uint32_t>(out, SCROLL_CACHE_VERSION);
+					write<std::uint64_t>(out, key);
+
+					// Scroll offsets of layers in breadth-first order of each layer tree
+					auto sp_arena = r_tuned_container.get_layer_arena();
+					write<std::uint64_t>(out, sp_arena->get_tree_count());
+					for (unsigned int frame_idx = 0; frame_idx < sp_arena->get_tree_count(); ++frame_idx)
+					{
+						const auto& r_layer_packs = sp_arena->get_layer_packs(frame_idx);
+						write<std::uint32_t>(out, (std::uint32_t)r_layer_packs.size());
+						for (const auto& r_pack : r_layer_packs)
+						{
+							write<std::int32_t>(out, r_pack.sptr->get_scroll_x());
+							write<std::int32_t>(out, r_pack.sptr->get_scroll_y());
+						}
+					}
+					written = out.good();
+				}
+				std::error_code ec;
+				if (written)
+				{
+					fs::rename(tmp_path, path, ec);
+				}
+				if (!written || ec)
+				{
+					fs::remove(tmp_path, ec);
+				}
+			}
+		}
+	}
+}
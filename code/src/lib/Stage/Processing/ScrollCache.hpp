@@ -0,0 +1,33 @@
+//! Scroll cache.
+/*!
+Persisted output of the tuning stage for one session, i.e., the tuned scroll offsets of every layer in every frame.
+The cache is keyed like the snapshot of the processing stage, see there. Unlike the snapshot, it is applied onto freshly
+parsed log dates, so it is also used when parsing is required, e.g., for visual debugging of the parser or by the Trainer
+and Finder. The processing stage does not store it for sessions that are stored in a snapshot.
+*/
+
+#pragma once
+
+#include <Data/Session.hpp>
+#include <Data/LogDatum.hpp>
+#include <cstdint>
+#include <memory>
+
+namespace stage
+{
+	namespace processing
+	{
+		namespace scroll_cache
+		{
+			// Compute key of the session. Returns false if scroll cache is disabled or screencast or datacast cannot be read
+			bool compute_key(const data::Session& r_session, std::uint64_t& r_key);
+
+			// Apply cached scroll offsets onto copies of the parsed log dates. Returns nullptr if there is no cache with the key
+			// or the cache does not fit the layer trees of the log dates
+			std::shared_ptr<data::LogDatumContainer> load(std::shared_ptr<const data::LogDatumContainer> sp_parsed_container, std::uint64_t key);
+
+			// Store scroll offsets of tuned log dates in cache with the key
+			void store(const data::LogDatumContainer& r_tuned_container, std::uint64_t key);
+		}
+	}
+}
@@ -0,0 +1,365 @@
+#include "Snapshot.hpp"
+#include <Core/Core.hpp>
+#include <experimental/filesystem>
+#include <fstream>
+#include <map>
+#include <cstring>
+#include <functional>
+
+namespace fs = std::experimental::filesystem;
+
+const std::string SNAPSHOT_DIRECTORY = core::mt::get_config_value(std::string(""), { "processing", "snapshot", "directory" });
+
+// Format of snapshot
+const std::string SNAPSHOT_SUFFIX = ".snapshot";
+const char SNAPSHOT_MAGIC[4] = { 'G', 'M', 'P', 'S' };
+const std::uint32_t SNAPSHOT_VERSION = 1;
+
+namespace stage
+{
+	namespace processing
+	{
+		namespace snapshot
+		{
+			// Writes values into a byte buffer
+			class Writer
+			{
+			public:
+
+				template<typename T>
+				void write(T value)
+				{
+					_buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+				}
+
+				void write_string(const std::string& r_value)
+				{
+					write<std::uint64_t>(r_value.size());
+					_buffer.append(r_value);
+				}
+
+				const std::string& get() const { return _buffer; }
+
+			private:
+
+				std::string _buffer;
+			};
+
+			// Reads values from a byte buffer. Values are zero after reading beyond the end
+			class Reader
+			{
+			public:
+
+				Reader(const std::vector<char>& r_buffer) : _r_buffer(r_buffer) {}
+
+				template<typename T>
+				T read()
+				{
+					T value = T();
+					if (_pos + sizeof(T) <= _r_buffer.size())
+					{
+						std::memcpy(&value, _r_buffer.data() + _pos, sizeof(T));
+						_pos += sizeof(T);
+					}
+					else
+					{
+						_failed = true;
+					}
+					return value;
+				}
+
+				std::string read_string()
+				{
+					std::uint64_t size = read<std::uint64_t>();
+					if (size > _r_buffer.size() - _pos)
+					{
+						_failed = true;
+						return "";
+					}
+					std::string value(_r_buffer.data() + _pos, (std::size_t)size);
+					_pos += (std::size_t)size;
+					return value;
+				}
+
+				bool failed() const { return _failed; }
+
+			private:
+
+				const std::vector<char>& _r_buffer;
+				std::size_t _pos = 0;
+				bool _failed = false;
+			};
+
+			// Path to snapshot of session
+			static std::string snapshot_path(const data::Session& r_session)
+			{
+				if (SNAPSHOT_DIRECTORY.empty())
+				{
+					return r_session.get_json_path() + SNAPSHOT_SUFFIX; // next to datacast
+				}
+				return (fs::path(SNAPSHOT_DIRECTORY) / (fs::path(r_session.get_json_path()).filename().string() + SNAPSHOT_SUFFIX)).string();
+			}
+
+			// Config values that influence the output of the processing stage, i.e., without parallelization and storage settings
+			static std::string config_fingerprint()
+			{
+				return core::mt::get_config_table({ "processing" }, {
+						"tuning.thread_count",
+						"tuning.frame_batch_size",
+						"tuning.scroll_cache",
+						"snapshot" })
+					+ ";" + core::mt::get_config_table({ "model", "processing" });
+			}
+
+			bool compute_key(const data::Session& r_session, std::uint64_t& r_key)
+			{
+				// Stamp input files by size and modification time, as hashing their content would be another pass over the screencast
+				std::uint64_t stamps[4] = { 0, 0, 0, 0 }; // size and modification time of screencast and datacast
+				std::int64_t webm_mtime = 0, json_mtime = 0;
+				if (!core::misc::stamp_file(r_session.get_webm_path(), stamps[0], webm_mtime)
+					|| !core::misc::stamp_file(r_session.get_json_path(), stamps[2], json_mtime))
+				{
+					return false;
+				}
+				stamps[1] = (std::uint64_t)webm_mtime;
+				stamps[3] = (std::uint64_t)json_mtime;
+
+				// Combine stamps of input files, frame limit, processing version, and config
+				const std::string fingerprint = config_fingerprint();
+				const std::int32_t frame_limit = r_session.get_frame_limit();
+				const std::uint32_t processing_version = PROCESSING_VERSION;
+				std::uint64_t key = core::misc::hash_bytes(reinterpret_cast<const char*>(stamps), sizeof(stamps));
+				key = core::misc::hash_bytes(reinterpret_cast<const char*>(&frame_limit), sizeof(frame_limit), key);
+				key = core::misc::hash_bytes(reinterpret_cast<const char*>(&processing_version), sizeof(processing_version), key);
+				key = core::misc::hash_bytes(fingerprint.data(), fingerprint.size(), key);
+				r_key = key;
+				return true;
+			}
+
+			std::shared_ptr<data::LogDatumContainer> load(std::shared_ptr<const data::Session> sp_session, std::uint64_t key)
+			{
+				// Read complete snapshot into memory
+				std::ifstream in(snapshot_path(*sp_session.get()), std::ios::binary | std::ios::ate);
+				if (!in.is_open()) { return nullptr; }
+				std::vector<char> buffer((std::size_t)in.tellg());
+				in.seekg(0);
+				in.read(buffer.data(), buffer.size());
+				if (!in.good()) { return nullptr; }
+				Reader reader(buffer);
+
+				// Compare header
+				char magic[4];
+				for (auto& r_char : magic) { r_char = reader.read<char>(); }
+				std::uint32_t version = reader.read<std::uint32_t>();
+				std::uint64_t snapshot_key = reader.read<std::uint64_t>();
+				if (reader.failed()
+					|| std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0
+					|| version != SNAPSHOT_VERSION
+					|| snapshot_key != key)
+				{
+					return nullptr;
+				}
+				double datacast_duration = reader.read<double>();
+
+				// Read layers, each with the indices of its children
+				struct LayerEntry
+				{
+					std::shared_ptr<data::Layer> sp_layer;
+					std::vector<std::uint64_t> children;
+				};
+				std::uint64_t layer_count = reader.read<std::uint64_t>();
+				if (layer_count > buffer.size()) { return nullptr; } // corrupt count
+				std::vector<LayerEntry> layers((std::size_t)layer_count);
+				for (std::uint64_t layer_idx = 0; layer_idx < layer_count && !reader.failed(); ++layer_idx)
+				{
+					auto sp_layer = data::Layer::create();
+					sp_layer->set_type((data::LayerType)reader.read<std::uint8_t>());
+					sp_layer->set_xpath(reader.read_string());
+					int view_x = reader.read<std::int32_t>();
+					int view_y = reader.read<std::int32_t>();
+					sp_layer->set_view_pos(cv::Point2i(view_x, view_y));
+					sp_layer->set_view_width(reader.read<std::int32_t>());
+					sp_layer->set_view_height(reader.read<std::int32_t>());
+					sp_layer->set_scroll_x(reader.read<std::int32_t>());
+					sp_layer->set_scroll_y(reader.read<std::int32_t>());
+					sp_layer->set_zindex(reader.read<std::int32_t>());
+
+					// Input
+					std::uint64_t input_count = reader.read<std::uint64_t>();
+					for (std::uint64_t input_idx = 0; input_idx < input_count && !reader.failed(); ++input_idx)
+					{
+						auto type = (data::InputType)reader.read<std::uint8_t>();
+						core::long64 time_ms = (core::long64)reader.read<std::int64_t>();
+						int input_x = reader.read<std::int32_t>();
+						int input_y = reader.read<std::int32_t>();
+						bool valid = reader.read<std::uint8_t>() > 0;
+						switch (type)
+						{
+						case data::InputType::Move: sp_layer->push_back_input(std::make_shared<data::MoveInput>(time_ms, input_x, input_y)); break;
+						case data::InputType::Click: sp_layer->push_back_input(std::make_shared<data::ClickInput>(time_ms, input_x, input_y)); break;
+						case data::InputType::Gaze: sp_layer->push_back_input(std::make_shared<data::GazeInput>(time_ms, input_x, input_y, valid)); break;
+						}
+					}
+
+					// Children (always stored after their parent, thus the tree cannot contain cycles)
+					std::uint64_t child_count = reader.read<std::uint64_t>();
+					for (std::uint64_t child_idx = 0; child_idx < child_count && !reader.failed(); ++child_idx)
+					{
+						std::uint64_t child = reader.read<std::uint64_t>();
+						if (child <= layer_idx || child >= layer_count) { return nullptr; }
+						layers.at((std::size_t)layer_idx).children.push_back(child);
+					}
+					layers.at((std::size_t)layer_idx).sp_layer = sp_layer;
+				}
+				if (reader.failed()) { return nullptr; }
+
+				// Build layer trees top-down, so children know the view size of their root when appended
+				std::vector<bool> built(layers.size(), false);
+				std::function<void(std::uint64_t)> build = [&](std::uint64_t layer_idx)
+				{
+					if (built.at((std::size_t)layer_idx)) { return; }
+					built.at((std::size_t)layer_idx) = true;
+					auto& r_entry = layers.at((std::size_t)layer_idx);
+					for (auto child : r_entry.children)
+					{
+						r_entry.sp_layer->append_child(layers.at((std::size_t)child).sp_layer);
+						build(child);
+					}
+				};
+
+				// Read log dates
+				auto sp_container = std::make_shared<data::LogDatumContainer>(sp_session, datacast_duration);
+				std::uint64_t datum_count = reader.read<std::uint64_t>();
+				for (std::uint64_t datum_idx = 0; datum_idx < datum_count && !reader.failed(); ++datum_idx)
+				{
+					double frame_time = reader.read<double>();
+					int on_screen_x = reader.read<std::int32_t>();
+					int on_screen_y = reader.read<std::int32_t>();
+					int viewport_x = reader.read<std::int32_t>();
+					int viewport_y = reader.read<std::int32_t>();
+					int viewport_width = reader.read<std::int32_t>();
+					int viewport_height = reader.read<std::int32_t>();
+					std::uint64_t root = reader.read<std::uint64_t>();
+					if (reader.failed() || root >= layer_count) { return nullptr; }
+					build(root);
+					sp_container->push_back(std::make_shared<data::LogDatum>(
+						frame_time,
+						layers.at((std::size_t)root).sp_layer,
+						cv::Point2i(on_screen_x, on_screen_y),
+						cv::Point2i(viewport_x, viewport_y),
+						viewport_width,
+						viewport_height));
+				}
+				if (reader.failed()) { return nullptr; }
+				return sp_container;
+			}
+
+			void store(const data::LogDatumContainer& r_container, std::uint64_t key)
+			{
+				auto sp_log_dates = r_container.get();
+
+				// Index layers, shared layers get a single index. Parents are indexed before their children
+				std::map<const data::Layer*, std::uint64_t> layer_indices;
+				std::vector<std::shared_ptr<const data::Layer> > layers;
+				std::function<void(std::shared_ptr<const data::Layer>)> index = [&](std::shared_ptr<const data::Layer> sp_layer)
+				{
+					if (!layer_indices.emplace(sp_layer.get(), layers.size()).second) { return; } // already indexed
+					layers.push_back(sp_layer);
+					for (unsigned int child_idx = 0; child_idx < sp_layer->get_child_count(); ++child_idx)
+					{
+						index(sp_layer->get_child(child_idx));
+					}
+				};
+				for (const auto& rsp_log_datum : *sp_log_dates.get())
+				{
+					index(rsp_log_datum->get_root());
+				}
+
+				// Header
+				Writer writer;
+				for (char c : SNAPSHOT_MAGIC) { writer.write<char>(c); }
+				writer.write<std::uint32_t>(SNAPSHOT_VERSION);
+				writer.write<std::uint64_t>(key);
+				writer.write<double>(r_container.get_datacast_duration());
+
+				// Layers
+				writer.write<std::uint64_t>(layers.size());
+				for (const auto& rsp_layer : layers)
+				{
+					writer.write<std::uint8_t>((std::uint8_t)rsp_layer->get_type());
+					writer.write_string(rsp_layer->get_xpath());
+					writer.write<std::int32_t>(rsp_layer->get_view_pos().x);
+					writer.write<std::int32_t>(rsp_layer->get_view_pos().y);
+					writer.write<std::int32_t>(rsp_layer->get_view_width());
+					writer.write<std::int32_t>(rsp_layer->get_view_height());
+					writer.write<std::int32_t>(rsp_layer->get_scroll_x());
+					writer.write<std::int32_t>(rsp_layer->get_scroll_y());
+					writer.write<std::int32_t>(rsp_layer->get_zindex());
+
+					// Input
+					auto input = rsp_layer->get_input();
+					writer.write<std::uint64_t>(input.size());
+					for (const auto& rsp_input : input)
+					{
+						auto sp_coordinate_input = std::dynamic_pointer_cast<const data::CoordinateInput>(rsp_input);
+						auto sp_gaze_input = std::dynamic_pointer_cast<const data::GazeInput>(rsp_input);
+						writer.write<std::uint8_t>((std::uint8_t)rsp_input->get_type());
+						writer.write<std::int64_t>(rsp_input->get_time_ms());
+						writer.write<std::int32_t>(sp_coordinate_input ? sp_coordinate_input->get_view_x() : 0);
+						writer.write<std::int32_t>(sp_coordinate_input ? sp_coordinate_input->get_view_y() : 0);
+						writer.write<std::uint8_t>(sp_gaze_input ? sp_gaze_input->is_valid() : 1);
+					}
+
+					// Children
+					writer.write<std::uint64_t>(rsp_layer->get_child_count());
+					for (unsigned int child_idx = 0; child_idx < rsp_layer->get_child_count(); ++child_idx)
+					{
+						writer.write<std::uint64_t>(layer_indices.at(rsp_layer->get_child(child_idx).get()));
+					}
+				}
+
+				// Log dates
+				writer.write<std::uint64_t>(sp_log_dates->size());
+				for (const auto& rsp_log_datum : *sp_log_dates.get())
+				{
+					writer.write<double>(rsp_log_datum->get_frame_time());
+					writer.write<std::int32_t>(rsp_log_datum->get_viewport_on_screen_pos().x);
+					writer.write<std::int32_t>(rsp_log_datum->get_viewport_on_screen_pos().y);
+					writer.write<std::int32_t>(rsp_log_datum->get_viewport_pos().x);
+					writer.write<std::int32_t>(rsp_log_datum->get_viewport_pos().y);
+					writer.write<std::int32_t>(rsp_log_datum->get_viewport_width());
+					writer.write<std::int32_t>(rsp_log_datum->get_viewport_height());
+					writer.write<std::uint64_t>(layer_indices.at(rsp_log_datum->get_root().get()));
+				}
+
+				// Write into temporary file first, so concurrent runs never read a partial snapshot
+				const std::string path = snapshot_path(*r_container.get_session().get());
+				const std::string tmp_path = core::misc::unique_tmp_path(path);
+				if (!SNAPSHOT_DIRECTORY.empty())
+				{
+					core::misc::create_directories(SNAPSHOT_DIRECTORY);
+				}
+				bool written = false;
+				{
+					std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+					if (!out.is_open())
+					{
+						core::mt::log_warn("Snapshot cannot be written: ", path);
+						return;
+					}
+					out.write(writer.get().data(), writer.get().size());
+					written = out.good();
+				}
+				std::error_code ec;
+				if (written)
+				{
+					fs::rename(tmp_path, path, ec);
+				}
+				if (!written || ec)
+				{
+					fs::remove(tmp_path, ec);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,37 @@
+//! Snapshot.
+/*!
+Versioned binary snapshot of the output of the processing stage for one session, i.e., the tuned log dates with
+viewport, layer trees, scroll offsets, and input. The snapshot is keyed by size and modification time of screencast and
+datacast, the frame limit, the processing version, and the config of the processing stage that affects its output, so
+reruns on identical input skip the processing. Input files are stamped instead of hashed to avoid another pass over the
+screencast, thus a file rewritten with identical size and modification time is not detected.
+Layers shared among log dates are stored once and shared again when the snapshot is loaded.
+*/
+
+#pragma once
+
+#include <Data/Session.hpp>
+#include <Data/LogDatum.hpp>
+#include <cstdint>
+#include <memory>
+
+namespace stage
+{
+	namespace processing
+	{
+		namespace snapshot
+		{
+			// Version of the output of parser and tuning, part of the key. Increase whenever that output changes
+			const std::uint32_t PROCESSING_VERSION = 5;
+
+			// Compute key of the session. Returns false if screencast or datacast cannot be read
+			bool compute_key(const data::Session& r_session, std::uint64_t& r_key);
+
+			// Load log datum container of session from snapshot. Returns nullptr if there is no snapshot with the key
+			std::shared_ptr<data::LogDatumContainer> load(std::shared_ptr<const data::Session> sp_session, std::uint64_t key);
+
+			// Store log datum container in snapshot with the key
+			void store(const data::LogDatumContainer& r_container, std::uint64_t key);
+		}
+	}
+}
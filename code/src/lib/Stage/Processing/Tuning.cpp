@@ -2,11 +2,33 @@
 #include <Core/Core.hpp>
 #include <Util/LayerComparator.hpp>
 #include <libsimplewebm.hpp>
+#include <ThreadPool.h>
 #include <opencv2/features2d.hpp>
 #include <opencv2/calib3d.hpp>
+#include <opencv2/flann.hpp>
+#include <opencv2/core/hal/hal.hpp>
 #include <set>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <numeric>
 
 const int ORB_SCROLL_THRESHOLD = core::mt::get_config_value(225, { "processing", "tuning", "orb_scroll_threshold" });
+const bool FAST_SCROLL_ENABLE = core::mt::get_config_value(true, { "processing", "tuning", "fast_scroll", "enable" });
+const float FAST_SCROLL_MAX_DIFFERENCE = core::mt::get_config_value(2.f, { "processing", "tuning", "fast_scroll", "max_difference" });
+const float FAST_SCROLL_MIN_MARGIN = core::mt::get_config_value(4.f, { "processing", "tuning", "fast_scroll", "min_margin" });
+const float FAST_SCROLL_MIN_CONTRAST = core::mt::get_config_value(8.f, { "processing", "tuning", "fast_scroll", "min_contrast" });
+const int FAST_SCROLL_MAX_SCROLL = core::mt::get_config_value(400, { "processing", "tuning", "fast_scroll", "max_scroll" });
+const float FAST_SCROLL_MIN_OVERLAP = 0.5f; // minimal overlap of row profiles, relative to the shorter one
+const int THREAD_COUNT = core::mt::get_config_value(4, { "processing", "tuning", "thread_count" });
+const int FRAME_BATCH_SIZE = core::mt::get_config_value(32, { "processing", "tuning", "frame_batch_size" });
+const std::string MATCHER_TYPE = core::mt::get_config_value(std::string("brute_force"), { "processing", "tuning", "matcher", "type" });
+const int LSH_TABLE_COUNT = core::mt::get_config_value(6, { "processing", "tuning", "matcher", "lsh_table_count" });
+const int LSH_KEY_SIZE = core::mt::get_config_value(12, { "processing", "tuning", "matcher", "lsh_key_size" });
+const int LSH_MULTI_PROBE_LEVEL = core::mt::get_config_value(1, { "processing", "tuning", "matcher", "lsh_multi_probe_level" });
+const float BAND_MAX_SCROLL = core::mt::get_config_value(400.f, { "processing", "tuning", "matcher", "band_max_scroll" });
+const float BAND_TOLERANCE_X = core::mt::get_config_value(4.f, { "processing", "tuning", "matcher", "band_tolerance_x" });
 
 namespace stage
 {
@@ -16,146 +38,369 @@ namespace stage
 		{
 			Interface::~Interface() {}
 
+			// Worker pool shared by the ORBscrolls of all sessions
+			static ThreadPool& get_worker_pool()
+			{
+				static ThreadPool pool(std::max(1, THREAD_COUNT));
+				return pool;
+			}
+
+			std::string to_string(Matcher matcher)
+			{
+				switch (matcher)
+				{
+				case Matcher::LSH:
+					return "lsh";
+				case Matcher::Band:
+					return "band";
+				default: // brute force
+					return "brute_force";
+				}
+			}
+
+			Matcher to_matcher(const std::string& r_matcher)
+			{
+				if (r_matcher == "lsh") { return Matcher::LSH; }
+				if (r_matcher == "band") { return Matcher::Band; }
+				return Matcher::BruteForce;
+			}
+
+			ORBscrollSettings::ORBscrollSettings() :
+				matcher(to_matcher(MATCHER_TYPE)), fast_scroll(FAST_SCROLL_ENABLE) {}
+
+			// Find k nearest train descriptors of each query descriptor. LSH might find less than k or none
+			static void knn_match(
+				Matcher matcher,
+				const cv::Mat& r_query,
+				const cv::Mat& r_train,
+				std::vector<std::vector<cv::DMatch> >& r_matches,
+				int k)
+			{
+				if (matcher == Matcher::LSH)
+				{
+					cv::FlannBasedMatcher lsh_matcher(cv::makePtr<cv::flann::LshIndexParams>(LSH_TABLE_COUNT, LSH_KEY_SIZE, LSH_MULTI_PROBE_LEVEL));
+					lsh_matcher.knnMatch(r_query, r_train, r_matches, k);
+				}
+				else
+				{
+					cv::Ptr<cv::BFMatcher> bf_matcher = cv::BFMatcher::create(cv::NORM_HAMMING);
+					bf_matcher->knnMatch(r_query, r_train, r_matches, k);
+				}
+			}
+
+			// Find nearest current descriptor of each previous descriptor among the keypoints within a vertical band around the previous keypoint
+			static void band_match(
+				const std::vector<cv::KeyPoint>& r_prev_keypoints,
+				const cv::Mat& r_prev_descriptors,
+				const std::vector<cv::KeyPoint>& r_cur_keypoints,
+				const cv::Mat& r_cur_descriptors,
+				std::vector<cv::DMatch>& r_matches)
+			{
+				// Sort current keypoints by x-coordinate, so the candidates of a band are found by binary search
+				std::vector<int> order(r_cur_keypoints.size());
+				std::iota(order.begin(), order.end(), 0);
+				std::sort(order.begin(), order.end(), [&](int a, int b) { return r_cur_keypoints.at(a).pt.x < r_cur_keypoints.at(b).pt.x; });
+				std::vector<float> xs;
+				xs.reserve(order.size());
+				for (int idx : order) { xs.push_back(r_cur_keypoints.at(idx).pt.x); }
+
+				// Go over previous keypoints and compare with current keypoints in band
+				r_matches.clear();
+				for (int i = 0; i < (int)r_prev_keypoints.size(); ++i)
+				{
+					const cv::Point2f& r_pt = r_prev_keypoints.at(i).pt;
+					const uchar* p_query = r_prev_descriptors.ptr<uchar>(i);
+					auto it_begin = std::lower_bound(xs.begin(), xs.end(), r_pt.x - BAND_TOLERANCE_X);
+					auto it_end = std::upper_bound(xs.begin(), xs.end(), r_pt.x + BAND_TOLERANCE_X);
+					int best_idx = -1;
+					int best_distance = std::numeric_limits<int>::max();
+					for (auto it = it_begin; it != it_end; ++it)
+					{
+						int idx = order.at(it - xs.begin());
+						if (std::abs(r_cur_keypoints.at(idx).pt.y - r_pt.y) > BAND_MAX_SCROLL) { continue; }
+						int distance = cv::hal::normHamming(p_query, r_cur_descriptors.ptr<uchar>(idx), r_cur_descriptors.cols);
+						if (distance < best_distance)
+						{
+							best_distance = distance;
+							best_idx = idx;
+						}
+					}
+					if (best_idx >= 0)
+					{
+						r_matches.push_back(cv::DMatch(i, best_idx, (float)best_distance));
+					}
+				}
+			}
+
 			ORBscroll::ORBscroll(
 				VD(std::shared_ptr<core::visual_debug::Dump> sp_dump, )
-				std::shared_ptr<const data::LogDatumContainer> sp_log_datum_container)
+				std::shared_ptr<const data::LogDatumContainer> sp_log_datum_container,
+				ORBscrollSettings settings)
 				:
 				Interface(VD(sp_dump, ) sp_log_datum_container->get_session()->get_id()),
-				_up_walker(std::unique_ptr<util::LogDatesWalker>(new util::LogDatesWalker(sp_log_datum_container->get(), sp_log_datum_container->get_session()->get_webm_path())))
+				_settings(settings),
+				_up_walker(std::unique_ptr<util::LogDatesWalker>(new util::LogDatesWalker(sp_log_datum_container->get(), sp_log_datum_container->get_session()->get_frame_cache(), sp_log_datum_container->get_layer_arena())))
 			{
 				_sp_container = std::shared_ptr<ProductType>(new ProductType(sp_log_datum_container->get_session(), sp_log_datum_container->get_datacast_duration()));
 			}
 
 			std::shared_ptr<ORBscroll::ProductType> ORBscroll::internal_step()
 			{
-				// Walk one frame in screencast and log dates
-				if (_up_walker->step()) // another frame is available
+				// Walk a batch of frames in screencast and log dates
+				struct Frame
+				{
+					int frame_idx;
+					std::shared_ptr<const data::LogDatum> sp_log_datum;
+					std::shared_ptr<const data::LogImage> sp_log_image;
+					const data::LayerPacks* p_layer_packs; // shared by walker
+				};
+				std::vector<Frame> frames;
+				while ((int)frames.size() < std::max(1, FRAME_BATCH_SIZE) && _up_walker->step()) // another frame is available
 				{
-					// Store extended information about layers
-					std::deque<std::shared_ptr<ExLayer> > ex_layers;
+					frames.push_back({
+						_up_walker->get_frame_idx(),
+						_up_walker->get_log_datum(),
+						_up_walker->get_log_image(),
+						&_up_walker->get_layer_packs() });
+				}
 
-					// Retrieve all layers of that frame
-					auto layer_packs = _up_walker->get_layer_packs();
+				// No further frame available
+				if (frames.empty())
+				{
+					// Tell about hit-rate of estimators, e.g., to tune the thresholds of the row profile estimator
+					unsigned int total_count = _fast_scroll_count + _orb_scroll_count + _failed_scroll_count;
+					if (total_count > 0)
+					{
+						core::mt::log_info(
+							"Scroll estimation of ", _sp_container->get_session()->get_id(), ": ",
+							"row profile ", _fast_scroll_count, ", ",
+							"ORB (", to_string(_settings.matcher), ") ", _orb_scroll_count, ", ",
+							"failed ", _failed_scroll_count, " of ", total_count, " layer pairs (",
+							core::misc::to_percentage_str((float)_fast_scroll_count / (float)total_count), " by row profile)");
+					}
+					return _sp_container;
+				}
 
-					// Deep copy log datum (which is then tuned)
-					auto up_log_datum = _up_walker->get_log_datum()->deep_copy();
+				// Extract features of the layers of each frame in parallel
+				auto& r_pool = get_worker_pool();
+				std::vector<std::future<ExLayers> > ex_layers_futures;
+				for (const auto& r_frame : frames)
+				{
+					auto sp_log_image = r_frame.sp_log_image;
+					auto p_layer_packs = r_frame.p_layer_packs;
+					Matcher matcher = _settings.matcher;
+					bool fast_scroll = _settings.fast_scroll;
+					ex_layers_futures.push_back(r_pool.enqueue([sp_log_image, p_layer_packs, matcher, fast_scroll]() { return create_ex_layers(sp_log_image, *p_layer_packs, matcher, fast_scroll); }));
+				}
+				std::vector<ExLayers> ex_layers_of_frames;
+				for (auto& r_future : ex_layers_futures)
+				{
+					ex_layers_of_frames.push_back(r_future.get());
+				}
 
-					// Go over layers and add them to deque to be processed
-					for (const auto& r_pack : layer_packs)
+				// Estimate relative scrolling of each pair of subsequent frames in parallel. Makes only sense if this is not the first frame
+				std::vector<std::future<std::vector<Estimate> > > estimates_futures;
+				for (int i = 0; i < (int)frames.size(); ++i)
+				{
+					const ExLayers& r_prev_ex_layers = i > 0 ? ex_layers_of_frames.at(i - 1) : _prev_ex_layers; // empty for first frame
+					const ExLayers& r_ex_layers = ex_layers_of_frames.at(i);
+					int frame_idx = frames.at(i).frame_idx;
+					estimates_futures.push_back(r_pool.enqueue([this, frame_idx, &r_prev_ex_layers, &r_ex_layers]()
 					{
-						// Do skip fixed elements
-						// if (r_pack.sptr->get_type() == data::LayerType::Fixed) { continue; } // TODO: remove later?
-
-						// Extended layer automatically computes ORB features
-						ex_layers.push_back(std::shared_ptr<ExLayer>(
-							new ExLayer(
-								_up_walker->get_log_image(), // log image of the frame
-								up_log_datum->access_layer(r_pack.access) // get pointer to layer of deep copied log datum
-							)));
-					}
+						return estimate_frame_scrolling(frame_idx, r_prev_ex_layers, r_ex_layers);
+					}));
+				}
 
-					// Makes only sense to estimate scrolling if this is not the first frame
-					if (_up_walker->get_frame_idx() > 0)
+				std::vector<std::vector<Estimate> > estimates_of_frames;
+				for (auto& r_future : estimates_futures)
+				{
+					r_future.wait(); // ex layers must outlive all estimations, even if one throws
+				}
+				for (auto& r_future : estimates_futures)
+				{
+					estimates_of_frames.push_back(r_future.get()); // all estimations are done before ex layers are tuned below
+				}
+
+				// Apply absolute scrolling frame by frame, as it accumulates the tuned scrolling of the previous frame
+				for (int i = 0; i < (int)frames.size(); ++i)
+				{
+					const ExLayers& r_prev_ex_layers = i > 0 ? ex_layers_of_frames.at(i - 1) : _prev_ex_layers;
+					ExLayers& r_ex_layers = ex_layers_of_frames.at(i);
+					const auto& estimates = estimates_of_frames.at(i);
+
+					// Copy log datum (which is then tuned, layers are only copied when tuned)
+					auto up_log_datum = frames.at(i).sp_log_datum->copy();
+
+					// Go over layers of this frame that have been matched with a layer of the previous frame
+					for (int j = 0; j < (int)r_ex_layers.size(); ++j)
 					{
-						// Match layers of this frame with layer of previous frame
-						for (const auto sp_ex_layer : ex_layers) // current frame
+						const auto& r_estimate = estimates.at(j);
+						if (r_estimate.prev_idx < 0) { continue; }
+						auto sp_ex_layer = r_ex_layers.at(j);
+						auto sp_prev_layer = r_prev_ex_layers.at(r_estimate.prev_idx)->_sp_layer; // tuned, if tuned
+						auto sp_layer = sp_ex_layer->_sp_layer; // layer in current frame
+						VD(
+						auto sp_datum = r_estimate.sp_datum;
+						if (sp_datum) { _sp_dump->add(sp_datum); })
+						int vd_original_scroll_y = 0;
+						int vd_scroll_y = 0;
+
+						// Remember which estimator succeeded
+						switch (r_estimate.estimator)
 						{
-							for (const auto sp_prev_ex_layer : _prev_ex_layers) // previous frame
+						case Estimate::Estimator::RowProfile: ++_fast_scroll_count; break;
+						case Estimate::Estimator::ORB: ++_orb_scroll_count; break;
+						default: ++_failed_scroll_count; break;
+						}
+
+						// Check scrolling from previous frame and apply absolute scrolling
+						if (r_estimate.estimator != Estimate::Estimator::None)
+						{
+							// Store value for visual debugging
+							vd_original_scroll_y = sp_layer->get_scroll_y();
+
+							// Scrolling values
+							int scroll_x = sp_prev_layer->get_scroll_x() + (int)std::round(r_estimate.scroll_x);
+							int scroll_y = sp_prev_layer->get_scroll_y() + (int)std::round(r_estimate.scroll_y);
+
+							// Compare to stored scrolling (for root layer, only, others are not available in datacast)
+							if (sp_ex_layer->_sp_layer->get_type() == data::LayerType::Root)
 							{
-								// TODO remove matched prev frame from deque? otherwise might different current layers might match with the same previous frame
-
-								// Check similarity between layers across the two frames
-								auto sp_prev_layer = sp_prev_ex_layer->_sp_layer;
-								auto sp_layer = sp_ex_layer->_sp_layer; // layer in current frame
-								float similarity_score =
-									util::layer_comparator::compare(
-										sp_prev_layer,
-										sp_layer).value();
-								if (similarity_score > core::mt::get_config_value(0.5f, { "model", "processing", "layer_threshold" }))
+								int abs_diff_x = std::abs(scroll_x - sp_layer->get_scroll_x());
+								int abs_diff_y = std::abs(scroll_y - sp_layer->get_scroll_y());
+								if (abs_diff_x > ORB_SCROLL_THRESHOLD) // x-direction
+								{
+									scroll_x = sp_layer->get_scroll_x();
+								}
+								if (abs_diff_y > ORB_SCROLL_THRESHOLD) // y-direction
 								{
-									VD(
-									std::shared_ptr<core::visual_debug::Datum> sp_datum = nullptr;
-									if (_sp_dump)
-									{
-										sp_datum = vd_datum("Frame");
-										sp_datum->add(vd_strings("Frame: ")->add(std::to_string(_up_walker->get_frame_idx())));
-										sp_datum->add(vd_strings("Previous XPath: ")->add(sp_prev_layer->get_xpath()));
-										sp_datum->add(vd_strings("Current XPath: ")->add(sp_layer->get_xpath()));
-										_sp_dump->add(sp_datum);
-									})
-									int vd_original_scroll_y = 0;
-									int vd_scroll_y = 0;
-
-									// Similar enough, perform the ORB-based scrolling estimation
-									float relative_scroll_x = 0.f;
-									float relative_scroll_y = 0.f;
-									bool success = estimate_relative_scrolling(
-										VD(sp_datum, )
-										sp_prev_ex_layer,
-										sp_ex_layer,
-										relative_scroll_x,
-										relative_scroll_y);
-
-									// Check scrolling from previous frame and apply absolute scrolling
-									if(success)
-									{
-										// Store value for visual debugging
-										vd_original_scroll_y = sp_layer->get_scroll_y();
-
-										// Scrolling values
-										int scroll_x = sp_prev_layer->get_scroll_x() + (int)std::round(relative_scroll_x);
-										int scroll_y = sp_prev_layer->get_scroll_y() + (int)std::round(relative_scroll_y);
-
-										// Compare to stored scrolling (for root layer, only, others are not available in datacast)
-										if (sp_ex_layer->_sp_layer->get_type() == data::LayerType::Root)
-										{
-											int abs_diff_x = std::abs(scroll_x - sp_layer->get_scroll_x());
-											int abs_diff_y = std::abs(scroll_y - sp_layer->get_scroll_y());
-											if (abs_diff_x > ORB_SCROLL_THRESHOLD) // x-direction
-											{
-												scroll_x = sp_layer->get_scroll_x();
-											}
-											if (abs_diff_y > ORB_SCROLL_THRESHOLD) // y-direction
-											{
-												scroll_y = sp_layer->get_scroll_y();
-											}
-										}
-
-										sp_layer->set_scroll_x(scroll_x);
-										sp_layer->set_scroll_y(scroll_y);
-										
-										// Store value for visual debugging
-										vd_scroll_y = scroll_y;
-										
-									} // else: leave scrolling as reported by datacast
-
-									// Add some more info to the visual debug datum
-									VD(
-									if (sp_datum)
-									{
-										sp_datum->add(vd_strings("Frame Time: ")->add(std::to_string(up_log_datum->get_frame_time())));
-										sp_datum->add(vd_strings("Original Y-Scrolling: ")->add(std::to_string(vd_original_scroll_y)));
-										sp_datum->add(vd_strings("Y-Scrolling: ")->add(std::to_string(vd_scroll_y)));
-									})
-
-									break; // breaks for loop for this layer in the current frame
+									scroll_y = sp_layer->get_scroll_y();
 								}
 							}
-						}
-					}
 
-					// Store current ex layers into member as previous ex layers
-					_prev_ex_layers = ex_layers;
+							// Tune layer in copied log datum (copies shared layers) and compare against it in the next frame
+							auto sp_tuned_layer = up_log_datum->access_layer(sp_ex_layer->_access);
+							sp_tuned_layer->set_scroll_x(scroll_x);
+							sp_tuned_layer->set_scroll_y(scroll_y);
+							sp_ex_layer->_sp_layer = sp_tuned_layer;
+
+							// Store value for visual debugging
+							vd_scroll_y = scroll_y;
+
+						} // else: leave scrolling as reported by datacast
+
+						// Add some more info to the visual debug datum
+						VD(
+						if (sp_datum)
+						{
+							sp_datum->add(vd_strings("Frame Time: ")->add(std::to_string(up_log_datum->get_frame_time())));
+							sp_datum->add(vd_strings("Original Y-Scrolling: ")->add(std::to_string(vd_original_scroll_y)));
+							sp_datum->add(vd_strings("Y-Scrolling: ")->add(std::to_string(vd_scroll_y)));
+						})
+					}
 
 					// Store tuned log datum in product
 					_sp_container->push_back(std::move(up_log_datum));
+				}
+
+				// Store ex layers of last frame into member as previous ex layers
+				_prev_ex_layers = ex_layers_of_frames.back();
 
-					return nullptr; // not yet done
+				return nullptr; // not yet done
+			}
+
+			ORBscroll::ExLayers ORBscroll::create_ex_layers(
+				std::shared_ptr<const data::LogImage> sp_log_image,
+				const data::LayerPacks& r_layer_packs,
+				Matcher matcher,
+				bool fast_scroll)
+			{
+				// Go over layers and add them to deque to be processed
+				ExLayers ex_layers;
+				for (const auto& r_pack : r_layer_packs)
+				{
+					// Do skip fixed elements
+					// if (r_pack.sptr->get_type() == data::LayerType::Fixed) { continue; } // TODO: remove later?
+
+					// Extended layer automatically computes ORB features
+					ex_layers.push_back(std::shared_ptr<ExLayer>(
+						new ExLayer(
+							sp_log_image, // log image of the frame
+							r_pack.sptr, // layer, shared by copied log datum until tuned
+							r_pack.access, // access to layer in copied log datum
+							matcher, // matcher to find repetitive features
+							fast_scroll // whether row profile is computed
+						)));
 				}
-				else // no further frame available
+				return ex_layers;
+			}
+
+			std::vector<ORBscroll::Estimate> ORBscroll::estimate_frame_scrolling(
+				int frame_idx,
+				const ExLayers& r_prev_ex_layers,
+				const ExLayers& r_ex_layers) const
+			{
+				// Match layers of this frame with layer of previous frame
+				std::vector<Estimate> estimates(r_ex_layers.size());
+				for (int i = 0; i < (int)r_ex_layers.size(); ++i) // current frame
 				{
-					return _sp_container;
+					const auto& sp_ex_layer = r_ex_layers.at(i);
+					for (int j = 0; j < (int)r_prev_ex_layers.size(); ++j) // previous frame
+					{
+						// TODO remove matched prev frame from deque? otherwise might different current layers might match with the same previous frame
+
+						// Check similarity between layers across the two frames (scrolling is not compared, thus untuned layers are sufficient)
+						const auto& sp_prev_ex_layer = r_prev_ex_layers.at(j);
+						auto sp_prev_layer = sp_prev_ex_layer->_sp_layer;
+						auto sp_layer = sp_ex_layer->_sp_layer; // layer in current frame
+						float similarity_score =
+							util::layer_comparator::compare(
+								sp_prev_layer,
+								sp_layer).value();
+						if (similarity_score > core::mt::get_config_value(0.5f, { "model", "processing", "layer_threshold" }))
+						{
+							auto& r_estimate = estimates.at(i);
+							r_estimate.prev_idx = j;
+							VD(
+							std::shared_ptr<core::visual_debug::Datum> sp_datum = nullptr;
+							if (_sp_dump)
+							{
+								sp_datum = vd_datum("Frame");
+								sp_datum->add(vd_strings("Frame: ")->add(std::to_string(frame_idx)));
+								sp_datum->add(vd_strings("Previous XPath: ")->add(sp_prev_layer->get_xpath()));
+								sp_datum->add(vd_strings("Current XPath: ")->add(sp_layer->get_xpath()));
+								r_estimate.sp_datum = sp_datum; // added to dump when applied
+							})
+
+							// Similar enough, perform the row profile based scrolling estimation and fall back to the ORB-based one if not confident
+							if (_settings.fast_scroll && estimate_relative_scrolling_fast(
+								sp_prev_ex_layer,
+								sp_ex_layer,
+								r_estimate.scroll_x,
+								r_estimate.scroll_y))
+							{
+								r_estimate.estimator = Estimate::Estimator::RowProfile;
+								VD(if (sp_datum) { sp_datum->add(vd_strings("Estimator: ")->add("row profile")); })
+							}
+							else
+							{
+								if (estimate_relative_scrolling(
+									VD(sp_datum, )
+									sp_prev_ex_layer,
+									sp_ex_layer,
+									r_estimate.scroll_x,
+									r_estimate.scroll_y))
+								{
+									r_estimate.estimator = Estimate::Estimator::ORB;
+								}
+								VD(if (sp_datum) { sp_datum->add(vd_strings("Estimator: ")->add("ORB")); })
+							}
+
+							break; // breaks for loop for this layer in the current frame
+						}
+					}
 				}
+				return estimates;
 			}
 
 			void ORBscroll::internal_report(ReportType& r_report)
@@ -185,10 +430,24 @@ namespace stage
 
 				// TODO: implement x-scrolling
 
-				// Brute force matcher
-				cv::Ptr<cv::BFMatcher> matcher = cv::BFMatcher::create(cv::NORM_HAMMING);
+				// Match each previous descriptor with its nearest current descriptor
 				std::vector<cv::DMatch> matches;
-				matcher->match(sp_prev->_descriptors, sp_current->_descriptors, matches);
+				if (_settings.matcher == Matcher::Band)
+				{
+					band_match(sp_prev->_keypoints, sp_prev->_descriptors, sp_current->_keypoints, sp_current->_descriptors, matches);
+				}
+				else
+				{
+					std::vector<std::vector<cv::DMatch> > knn_matches;
+					knn_match(_settings.matcher, sp_prev->_descriptors, sp_current->_descriptors, knn_matches, 1);
+					for (const auto& r_knn_match : knn_matches)
+					{
+						if (!r_knn_match.empty() && r_knn_match.front().trainIdx >= 0) // LSH might find no neighbor
+						{
+							matches.push_back(r_knn_match.front());
+						}
+					}
+				}
 
 				// Below not required as fixed elements are treated within separated layers
 				// Filter for features which are on the same viewport position and similar for both frames
@@ -291,10 +550,108 @@ namespace stage
 				return success;
 			}
 
+			bool ORBscroll::estimate_relative_scrolling_fast(
+				std::shared_ptr<const ORBscroll::ExLayer> sp_prev,
+				std::shared_ptr<const ORBscroll::ExLayer> sp_current,
+				float& r_scroll_x,
+				float& r_scroll_y) const
+			{
+				// Row profiles are only comparable if horizontal extent of layer is unchanged
+				const cv::Rect& r_prev_rect = sp_prev->_profile_rect;
+				const cv::Rect& r_cur_rect = sp_current->_profile_rect;
+				if (sp_prev->_row_profile.empty() || sp_current->_row_profile.empty()
+					|| r_prev_rect.x != r_cur_rect.x || r_prev_rect.width != r_cur_rect.width)
+				{
+					return false;
+				}
+				const float* p_prev = sp_prev->_row_profile.ptr<float>(0);
+				const float* p_prev_weights = sp_prev->_row_weights.ptr<float>(0);
+				const float* p_cur = sp_current->_row_profile.ptr<float>(0);
+				const float* p_cur_weights = sp_current->_row_weights.ptr<float>(0);
+
+				// Profile without contrast matches at any offset, e.g., a blank page
+				float sum = 0.f, squared_sum = 0.f, count = 0.f;
+				for (int i = 0; i < r_cur_rect.height; ++i)
+				{
+					if (p_cur_weights[i] > 0.f)
+					{
+						sum += p_cur[i];
+						squared_sum += p_cur[i] * p_cur[i];
+						count += 1.f;
+					}
+				}
+				if (count <= 0.f) { return false; }
+				float mean = sum / count;
+				if (std::sqrt(std::max(0.f, squared_sum / count - mean * mean)) < FAST_SCROLL_MIN_CONTRAST)
+				{
+					return false;
+				}
+
+				// Try all offsets with enough overlap, up to the max expected scrolling between subsequent frames. Content at viewport
+				// row y in the previous frame is at row y - offset in the current frame
+				const int min_overlap = std::max(1, (int)(FAST_SCROLL_MIN_OVERLAP * (float)std::min(r_prev_rect.height, r_cur_rect.height)));
+				const int overlap_min_offset = r_prev_rect.y - (r_cur_rect.y + r_cur_rect.height) + min_overlap;
+				const int overlap_max_offset = (r_prev_rect.y + r_prev_rect.height) - r_cur_rect.y - min_overlap;
+				const int min_offset = std::max(overlap_min_offset, -FAST_SCROLL_MAX_SCROLL);
+				const int max_offset = std::min(overlap_max_offset, FAST_SCROLL_MAX_SCROLL);
+				std::vector<float> differences;
+				differences.reserve(std::max(0, max_offset - min_offset + 1));
+				for (int offset = min_offset; offset <= max_offset; ++offset)
+				{
+					// Mean absolute difference within overlap of both profiles
+					int y_start = std::max(r_prev_rect.y, r_cur_rect.y + offset);
+					int y_end = std::min(r_prev_rect.y + r_prev_rect.height, r_cur_rect.y + r_cur_rect.height + offset);
+					const float* p_prev_row = p_prev + (y_start - r_prev_rect.y);
+					const float* p_prev_weight = p_prev_weights + (y_start - r_prev_rect.y);
+					const float* p_cur_row = p_cur + (y_start - offset - r_cur_rect.y);
+					const float* p_cur_weight = p_cur_weights + (y_start - offset - r_cur_rect.y);
+					float difference = 0.f;
+					int overlap = 0;
+					for (int i = 0; i < y_end - y_start; ++i)
+					{
+						if (p_prev_weight[i] > 0.f && p_cur_weight[i] > 0.f)
+						{
+							difference += std::abs(p_prev_row[i] - p_cur_row[i]);
+							++overlap;
+						}
+					}
+					differences.push_back(overlap >= min_overlap ? difference / (float)overlap : std::numeric_limits<float>::max());
+				}
+				if (differences.empty()) { return false; }
+
+				// Best offset must match well and clearly better than offsets that are not its neighbors
+				int best_idx = (int)(std::min_element(differences.begin(), differences.end()) - differences.begin());
+				float best = differences.at(best_idx);
+				float second_best = std::numeric_limits<float>::max();
+				for (int i = 0; i < (int)differences.size(); ++i)
+				{
+					if (std::abs(i - best_idx) > 2) { second_best = std::min(second_best, differences.at(i)); }
+				}
+				if (best > FAST_SCROLL_MAX_DIFFERENCE || second_best - best < FAST_SCROLL_MIN_MARGIN)
+				{
+					return false;
+				}
+
+				// Best offset at a bound of the window that cuts off offsets with enough overlap might be a slope towards a better one outside
+				if ((best_idx == 0 && min_offset > overlap_min_offset)
+					|| (best_idx == (int)differences.size() - 1 && max_offset < overlap_max_offset))
+				{
+					return false;
+				}
+
+				// Confident estimation, no x-scrolling
+				r_scroll_x = 0.f;
+				r_scroll_y = (float)(min_offset + best_idx);
+				return true;
+			}
+
 			ORBscroll::ExLayer::ExLayer(
 				std::shared_ptr<const data::LogImage> sp_image,
-				std::shared_ptr<data::Layer> sp_layer) :
-				_sp_image(sp_image), _sp_layer(sp_layer)
+				std::shared_ptr<const data::Layer> sp_layer,
+				std::vector<unsigned int> access,
+				Matcher matcher,
+				bool fast_scroll) :
+				_sp_image(sp_image), _sp_layer(sp_layer), _access(access)
 			{
 				// TODO issue: either create once features for complete screenshot and then have problems with layers influencing each other
 				// or do it per layer and mask other layers from screenshot
@@ -302,41 +659,78 @@ namespace stage
 				// Create gray clone of viewport image
 				const cv::Mat& gray = sp_image->get_viewport_pixels_gray();
 
-				// Detect ORB keypoints
+				// Detect ORB keypoints in cells of a grid, directly on cell regions of the gray image
 				const int CELL_COUNT_X = 4; // cell count
 				const int CELL_COUNT_Y = 3;
+				const float ORB_SCALE_FACTOR = 1.2f; // default pyramid parameters of ORB
+				const int ORB_LEVEL_COUNT = 8;
+				const int ORB_EDGE_THRESHOLD = 31; // default edge threshold and patch size of ORB, keypoints closer to the border of a level are discarded
+				const int ORB_BORDER = (int)std::ceil(ORB_EDGE_THRESHOLD * std::pow(ORB_SCALE_FACTOR, ORB_LEVEL_COUNT - 1)); // border in pixels of the coarsest level
 				int cell_size_x = gray.size().width / CELL_COUNT_X;
 				int cell_size_y = gray.size().height / CELL_COUNT_Y;
-				cv::Ptr<cv::FeatureDetector> detector = cv::ORB::create(1000 / (CELL_COUNT_X * CELL_COUNT_Y)); // make ~1000 keypoints in total
+				cv::Ptr<cv::ORB> detector = cv::ORB::create(
+					1000 / (CELL_COUNT_X * CELL_COUNT_Y), // make ~1000 keypoints in total
+					ORB_SCALE_FACTOR,
+					ORB_LEVEL_COUNT,
+					ORB_EDGE_THRESHOLD,
+					0, // first level
+					2, // WTA_K
+					cv::ORB::HARRIS_SCORE,
+					ORB_EDGE_THRESHOLD); // patch size
 				_keypoints.clear();
-				const cv::Mat viewport_layer_mask = sp_layer->get_view_mask();
+				const cv::Rect layer_rect = sp_layer->get_view_mask_rect(); // cells outside of it have no keypoints of this layer
+				const cv::Rect gray_rect(0, 0, gray.cols, gray.rows);
+				cv::Mat viewport_layer_mask; // rasterized only if any cell intersects the layer
+
+				// Compute mean gray value of each row within the layer, as used by the row profile scrolling estimation
+				_profile_rect = fast_scroll ? layer_rect & gray_rect : cv::Rect();
+				if (_profile_rect.area() > 0)
+				{
+					viewport_layer_mask = sp_layer->get_view_mask();
+					cv::Mat gray_values, weights;
+					gray(_profile_rect).convertTo(gray_values, CV_32F);
+					viewport_layer_mask(_profile_rect).convertTo(weights, CV_32F, 1.0 / 255.0);
+					cv::reduce(gray_values.mul(weights), _row_profile, 1, cv::REDUCE_SUM, CV_32F); // one column
+					cv::reduce(weights, _row_weights, 1, cv::REDUCE_SUM, CV_32F); // count of layer pixels per row
+					cv::Mat counts = cv::max(_row_weights, 1.0); // avoid division by zero for rows without layer pixels
+					_row_profile /= counts;
+				}
 				for (int y = 0; y < CELL_COUNT_Y; y++)
 				{
 					for (int x = 0; x < CELL_COUNT_X; x++)
 					{
-						std::vector<cv::KeyPoint> keypoints;
-						cv::Mat mask(gray.size(), CV_8UC1, cv::Scalar(0)); // create empty mask
 						cv::Rect rect(x * cell_size_x, y * cell_size_y, cell_size_x, cell_size_y);
-						viewport_layer_mask(rect).copyTo(mask(rect)); // TODO: strong assumption, that that mask (coming from image) and viewport_layer_mask (coming from combination of image and datacast) have the same extent?
-						detector->detect(gray, keypoints, mask);
-						_keypoints.insert(_keypoints.end(), keypoints.begin(), keypoints.end());
+						cv::Rect layer_cell_rect = rect & layer_rect;
+						if (layer_cell_rect.area() <= 0) { continue; }
+						if (viewport_layer_mask.empty()) { viewport_layer_mask = sp_layer->get_view_mask(); }
+
+						// Detect in region around the cell, so keypoints at the cell border keep their neighborhood
+						cv::Rect roi(
+							rect.x - ORB_BORDER,
+							rect.y - ORB_BORDER,
+							rect.width + 2 * ORB_BORDER,
+							rect.height + 2 * ORB_BORDER);
+						roi &= gray_rect;
+						cv::Mat mask(roi.size(), CV_8UC1, cv::Scalar(0)); // mask of region, only the cell is taken from the layer mask
+						cv::Rect mask_rect(layer_cell_rect.x - roi.x, layer_cell_rect.y - roi.y, layer_cell_rect.width, layer_cell_rect.height);
+						viewport_layer_mask(layer_cell_rect).copyTo(mask(mask_rect)); // TODO: strong assumption, that that mask (coming from image) and viewport_layer_mask (coming from combination of image and datacast) have the same extent?
+						std::vector<cv::KeyPoint> keypoints;
+						detector->detect(gray(roi), keypoints, mask);
 
-						/*
-						std::string window_name = "window-" + std::to_string(x) + "-" + std::to_string(y);
-						cv::namedWindow(window_name, cv::WINDOW_AUTOSIZE);
-						// cv::imshow(window_name, sp_intra_user_state->get_covered_stitched_screenshot());
-						cv::imshow(window_name, mask_area);
-						cv::waitKey(0);
-						cv::destroyWindow(window_name);
-						*/
+						// Move keypoints from region into viewport space
+						for (auto& r_keypoint : keypoints)
+						{
+							r_keypoint.pt.x += (float)roi.x;
+							r_keypoint.pt.y += (float)roi.y;
+						}
+						_keypoints.insert(_keypoints.end(), keypoints.begin(), keypoints.end());
 					}
 				}
 
-				// Compute descriptors
+				// Compute descriptors once, keypoints without descriptor are removed by ORB
 				if (!_keypoints.empty())
 				{
-					auto extractor = cv::ORB::create((int)_keypoints.size());
-					extractor->compute(gray, _keypoints, _descriptors);
+					detector->compute(gray, _keypoints, _descriptors);
 				}
 
 				/*
@@ -368,36 +762,43 @@ namespace stage
 				*/
 				
 				// Compute intra similarity (Web page might have repetive elements which will confuse features)
-				cv::Ptr<cv::BFMatcher> matcher = cv::BFMatcher::create(cv::NORM_HAMMING);
+				if (_keypoints.empty() || _descriptors.empty()) { return; }
 				std::vector<std::vector<cv::DMatch> > matches;
-				matcher->knnMatch(_descriptors, _descriptors, matches, 2); // k = 1 would only output similarity with itself
+				knn_match(
+					matcher == Matcher::LSH ? Matcher::LSH : Matcher::BruteForce, // repetitions are not limited to a band
+					_descriptors, _descriptors, matches, 2); // k = 1 would only output similarity with itself
 
-				// Throw away keypoints which descriptors are matching too good (similar within image)
-				std::set<int> to_delete;
+				// Mark keypoints which descriptors are matching too good (similar within image)
+				std::vector<bool> to_delete(_keypoints.size(), false);
+				bool any_to_delete = false;
 				for (const auto& r_match : matches)
 				{
 					for (const auto& r_inner_match : r_match)
 					{
-						if ((r_inner_match.queryIdx != r_inner_match.trainIdx) && r_inner_match.distance < 5)
+						if (r_inner_match.trainIdx >= 0 && (r_inner_match.queryIdx != r_inner_match.trainIdx) && r_inner_match.distance < 5)
 						{
-							to_delete.emplace(r_inner_match.queryIdx);
-							to_delete.emplace(r_inner_match.trainIdx);
+							to_delete.at(r_inner_match.queryIdx) = true;
+							to_delete.at(r_inner_match.trainIdx) = true;
+							any_to_delete = true;
 						}
 					}
 				}
 
-				// Remove all too good keypoints (back to front)
-				for (auto it = to_delete.rbegin(); it != to_delete.rend(); ++it)
-				{
-					_keypoints.erase(_keypoints.begin() + *it);
-				}
-
-				// Recompute descriptors (probably not required, one could remove descriptor rows according to deleted keypoints)
-				_descriptors = cv::Mat();
-				if (!_keypoints.empty())
+				// Remove all too good keypoints together with their descriptor rows in one pass
+				if (any_to_delete)
 				{
-					auto extractor = cv::ORB::create((int)_keypoints.size());
-					extractor->compute(gray, _keypoints, _descriptors);
+					std::vector<cv::KeyPoint> keypoints;
+					cv::Mat descriptors;
+					for (int i = 0; i < (int)_keypoints.size(); ++i)
+					{
+						if (!to_delete.at(i))
+						{
+							keypoints.push_back(_keypoints.at(i));
+							descriptors.push_back(_descriptors.row(i));
+						}
+					}
+					_keypoints = keypoints;
+					_descriptors = descriptors;
 				}
 			}
 		}
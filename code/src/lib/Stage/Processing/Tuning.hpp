@@ -3,7 +3,7 @@
 Interface for multi-threaded tunings that are applied on log dates.
 */
 
-// works on deep copy of log dates
+// works on copy of log dates, only tuned layers are copied
 
 /* TODO: general issues
  * - do it only for layers that are scroll able (aka not fixed...)
@@ -18,6 +18,7 @@ Interface for multi-threaded tunings that are applied on log dates.
 #include <memory>
 #include <vector>
 #include <deque>
+#include <string>
 
 namespace stage
 {
@@ -49,6 +50,27 @@ namespace stage
 			/// Fixing the scrolling with ORB features
 			/////////////////////////////////////////////////
 
+			// Backend to match ORB descriptors between layers
+			enum class Matcher
+			{
+				BruteForce, // compares all descriptors
+				LSH, // multi-probe locality sensitive hashing through FLANN, approximate
+				Band // compares only keypoints within a vertical band of plausible scrolling
+			};
+
+			// Convert matcher to std::string and back. Unknown strings are converted to brute force
+			std::string to_string(Matcher matcher);
+			Matcher to_matcher(const std::string& r_matcher);
+
+			// Settings of ORBscroll, defaults are read from config
+			struct ORBscrollSettings
+			{
+				ORBscrollSettings();
+
+				Matcher matcher; // backend to match descriptors, also used to find repetitive features within a layer
+				bool fast_scroll; // whether scrolling is first estimated by row profiles
+			};
+
 			// Apply fixing of scroll estimation through ORB features detection
 			class ORBscroll : public Interface
 			{
@@ -57,7 +79,8 @@ namespace stage
 				// Constructor
 				ORBscroll(
 					VD(std::shared_ptr<core::visual_debug::Dump> sp_dump, )
-					std::shared_ptr<const data::LogDatumContainer> sp_log_datum_container);
+					std::shared_ptr<const data::LogDatumContainer> sp_log_datum_container,
+					ORBscrollSettings settings = ORBscrollSettings());
 
 			protected:
 
@@ -75,15 +98,56 @@ namespace stage
 				public:
 					ExLayer(
 						std::shared_ptr<const data::LogImage> sp_image,
-						std::shared_ptr<data::Layer> sp_layer);
+						std::shared_ptr<const data::Layer> sp_layer,
+						std::vector<unsigned int> access,
+						Matcher matcher,
+						bool fast_scroll); // row profile is only computed for fast scrolling estimation
 
 					// Members
 					std::shared_ptr<const data::LogImage> _sp_image = nullptr;
-					std::shared_ptr<data::Layer> _sp_layer = nullptr; // non-const as that is tuned
+					std::shared_ptr<const data::Layer> _sp_layer = nullptr; // replaced by tuned layer when tuned
+					std::vector<unsigned int> _access; // access to layer in log datum, used to retrieve layer for tuning
 					std::vector<cv::KeyPoint> _keypoints;
 					cv::Mat _descriptors;
+					cv::Rect _profile_rect; // rect of layer in viewport space covered by row profile, empty if fast scrolling is disabled
+					cv::Mat _row_profile; // mean gray value of layer pixels per row of profile rect, one float column
+					cv::Mat _row_weights; // count of layer pixels per row of profile rect, one float column
 				};
 
+				// Typedef
+				typedef std::deque<std::shared_ptr<ExLayer> > ExLayers;
+
+				// Relative scrolling of a layer against the matched layer of the previous frame
+				struct Estimate
+				{
+					enum class Estimator { None, RowProfile, ORB }; // estimator that succeeded, none if all failed
+					int prev_idx = -1; // index of matched ex layer in previous frame, negative if no layer matched
+					Estimator estimator = Estimator::None;
+					float scroll_x = 0.f;
+					float scroll_y = 0.f;
+					VD(std::shared_ptr<core::visual_debug::Datum> sp_datum = nullptr;) // added to dump when scrolling is applied
+				};
+
+				// Create ex layers of all layers of a frame. Thread-safe
+				static ExLayers create_ex_layers(
+					std::shared_ptr<const data::LogImage> sp_log_image,
+					const data::LayerPacks& r_layer_packs,
+					Matcher matcher,
+					bool fast_scroll);
+
+				// Match ex layers of a frame with the ones of the previous frame and estimate relative scrolling, one estimate per ex layer. Thread-safe
+				std::vector<Estimate> estimate_frame_scrolling(
+					int frame_idx,
+					const ExLayers& r_prev_ex_layers,
+					const ExLayers& r_ex_layers) const;
+
+				// Estimate scrolling between two ex layers by cross-correlating their row profiles. Returns whether confident
+				bool estimate_relative_scrolling_fast(
+					std::shared_ptr<const ExLayer> sp_prev,
+					std::shared_ptr<const ExLayer> sp_current,
+					float& r_scroll_x,
+					float& r_scroll_y) const;
+
 				// Estimate scrolling between two ex layers. Returns whether successful
 				bool estimate_relative_scrolling(
 					VD(std::shared_ptr<core::visual_debug::Datum> sp_datum, )
@@ -96,8 +160,12 @@ namespace stage
 				std::shared_ptr<ProductType> _sp_container;
 
 				// Members
+				const ORBscrollSettings _settings;
 				std::unique_ptr<util::LogDatesWalker> _up_walker = nullptr;
-				std::deque<std::shared_ptr<ExLayer> > _prev_ex_layers;
+				ExLayers _prev_ex_layers; // of last frame of previous batch
+				unsigned int _fast_scroll_count = 0; // layer pairs estimated by row profile
+				unsigned int _orb_scroll_count = 0; // layer pairs estimated by ORB
+				unsigned int _failed_scroll_count = 0; // layer pairs where no estimator succeeded
 			};
 		}
 	}
@@ -8,9 +8,38 @@ namespace stage
 	{
 		namespace model
 		{
-			Result compute(
+			bool find_changed_rows(
+				const std::vector<std::uint64_t>& r_latest_row_hashes,
+				int latest_x_offset,
+				int latest_y_offset,
+				const std::vector<std::uint64_t>& r_row_hashes,
+				int x_offset,
+				int y_offset,
+				int& r_begin,
+				int& r_end)
+			{
+				// Without horizontally aligned latest rows, all rows are considered as changed
+				const int row_count = (int)r_row_hashes.size();
+				r_begin = 0;
+				r_end = row_count;
+				if (r_latest_row_hashes.empty() || latest_x_offset != x_offset)
+				{
+					return row_count > 0;
+				}
+
+				// Row of pixels corresponds to row of latest pixels with same global y-coordinate
+				auto unchanged = [&](int i) -> bool
+				{
+					int latest_i = i + y_offset - latest_y_offset;
+					return latest_i >= 0 && latest_i < (int)r_latest_row_hashes.size() && r_latest_row_hashes[latest_i] == r_row_hashes[i];
+				};
+				while (r_begin < r_end && unchanged(r_begin)) { ++r_begin; }
+				while (r_end > r_begin && unchanged(r_end - 1)) { --r_end; }
+				return r_begin < r_end;
+			}
+
+			Comparison prepare(
 				VD(std::shared_ptr<core::visual_debug::Datum> sp_datum, )
-				std::shared_ptr<const core::VisualChangeClassifier> sp_classifier,
 				const cv::Mat transformed_current_pixels,
 				std::shared_ptr<const data::Layer> sp_current_layer,
 				const cv::Mat potential_pixels,
@@ -21,6 +50,8 @@ namespace stage
 					&& transformed_current_pixels.cols == potential_pixels.cols
 					&& transformed_current_pixels.channels() == potential_pixels.channels()));
 
+				Comparison comparison;
+
 				// Overlap and crop the two input images
 				auto sp_overlap_current = std::make_shared<cv::Mat>();
 				auto sp_overlap_potential = std::make_shared<cv::Mat>();
@@ -32,15 +63,13 @@ namespace stage
 
 				if (!overlap)
 				{
-					return Result::no_overlap;
+					comparison.result = Result::no_overlap;
 				}
 				else
 				{
 					// Prepare visual debug output
 					VD(
 					std::shared_ptr<core::visual_debug::Datum> sp_split_datum = nullptr;
-					std::shared_ptr<core::visual_debug::Datum> sp_current_details_datum = nullptr;
-					std::shared_ptr<core::visual_debug::Datum> sp_potential_details_datum = nullptr;
 					if (sp_datum)
 					{
 						sp_split_datum = vd_datum("Simple Split Model");
@@ -56,31 +85,64 @@ namespace stage
 					// Check for perfect similarity
 					if (core::opencv::pixel_perfect_same(*sp_overlap_current, *sp_overlap_potential))
 					{
-						return Result::same; // do not split
-					}
-
-					// Feature vector
-					feature::FeatureVector feature_vector(sp_overlap_current, sp_overlap_potential);
-					auto features = feature_vector.get();
-
-					// Store feature observations
-					auto sp_dataset = std::make_shared<data::Dataset>(feature_vector.get_names());
-					sp_dataset->append_observation(features);
-					sp_dataset->normalize(sp_classifier->get_min_max());
-
-					// Classify the observation using the trained random forest
-					auto sp_labels = sp_classifier->classify(sp_dataset);
-	
-					// Check for label of classified observation
-					if ((*sp_labels)(0) > 0.0)
-					{
-						return Result::different;
+						comparison.result = Result::same; // do not split
 					}
 					else
 					{
-						return Result::same;
+						// Feature vector, classified later
+						feature::FeatureVector feature_vector(sp_overlap_current, sp_overlap_potential);
+						comparison.features = feature_vector.get();
+						comparison.feature_names = feature_vector.get_names();
+						comparison.pending = true;
 					}
 				}
+				return comparison;
+			}
+
+			void classify(
+				std::shared_ptr<const core::VisualChangeClassifier> sp_classifier,
+				const std::vector<Comparison*>& r_comparisons)
+			{
+				// Store feature observations of pending comparisons in one dataset
+				std::shared_ptr<data::Dataset> sp_dataset = nullptr;
+				std::vector<Comparison*> pending;
+				for (auto p_comparison : r_comparisons)
+				{
+					if (!p_comparison->pending) { continue; }
+					if (!sp_dataset) { sp_dataset = std::make_shared<data::Dataset>(p_comparison->feature_names); }
+					sp_dataset->append_observation(p_comparison->features);
+					pending.push_back(p_comparison);
+				}
+				if (pending.empty()) { return; }
+				sp_dataset->normalize(sp_classifier->get_min_max());
+
+				// Classify the observations using the trained random forest
+				auto sp_labels = sp_classifier->classify(sp_dataset);
+
+				// Check for label of each classified observation
+				for (int i = 0; i < (int)pending.size(); ++i)
+				{
+					pending.at(i)->result = (*sp_labels)(i) > 0.0 ? Result::different : Result::same;
+					pending.at(i)->pending = false;
+				}
+			}
+
+			Result compute(
+				VD(std::shared_ptr<core::visual_debug::Datum> sp_datum, )
+				std::shared_ptr<const core::VisualChangeClassifier> sp_classifier,
+				const cv::Mat transformed_current_pixels,
+				std::shared_ptr<const data::Layer> sp_current_layer,
+				const cv::Mat potential_pixels,
+				std::shared_ptr<const data::Layer> sp_potential_layer)
+			{
+				Comparison comparison = prepare(
+					VD(sp_datum, )
+					transformed_current_pixels,
+					sp_current_layer,
+					potential_pixels,
+					sp_potential_layer);
+				classify(sp_classifier, { &comparison });
+				return comparison.result;
 			}
 		}
 	}
@@ -10,6 +10,10 @@ Provides decision whether split of log dates into different intra-user states sh
 #include <Core/VisualDebug.hpp>
 #include <opencv2/core/types.hpp>
 #include <memory>
+#include <vector>
+#include <cstdint>
+#include <map>
+#include <string>
 
 namespace stage
 {
@@ -23,7 +27,42 @@ namespace stage
 				no_overlap
 			};
 
-			// Check whether split it recommended
+			// Find band of rows in pixels that differ from the latest pixels, aligned by their offsets. Rows not covered by the latest
+			// pixels differ. Band is [r_begin, r_end) in rows of pixels. Returns false if no row differs. Note that the reference is
+			// the latest frame of an intra-user state, not its stitched screenshot as in the split model
+			bool find_changed_rows(
+				const std::vector<std::uint64_t>& r_latest_row_hashes,
+				int latest_x_offset,
+				int latest_y_offset,
+				const std::vector<std::uint64_t>& r_row_hashes,
+				int x_offset,
+				int y_offset,
+				int& r_begin,
+				int& r_end);
+
+			// Comparison of current pixels and potential pixels. Result is final unless features are pending for classification
+			struct Comparison
+			{
+				Result result = Result::same;
+				bool pending = false; // whether features have to be classified to get the result
+				std::map<std::string, double> features;
+				std::vector<std::string> feature_names;
+			};
+
+			// Compare current pixels and potential pixels as far as possible without classifier. Thread-safe
+			Comparison prepare(
+				VD(std::shared_ptr<core::visual_debug::Datum> sp_datum, )
+				const cv::Mat transformed_current_pixels,
+				std::shared_ptr<const data::Layer> sp_current_layer,
+				const cv::Mat potential_pixels,
+				std::shared_ptr<const data::Layer> sp_potential_layer);
+
+			// Classify pending comparisons in one batch and set their results
+			void classify(
+				std::shared_ptr<const core::VisualChangeClassifier> sp_classifier,
+				const std::vector<Comparison*>& r_comparisons);
+
+			// Check whether split it recommended (prepare and classify a single comparison)
 			Result compute(
 				VD(std::shared_ptr<core::visual_debug::Datum> sp_datum, )
 				std::shared_ptr<const core::VisualChangeClassifier> sp_classifier,
@@ -2,13 +2,25 @@
 #include <Stage/Splitting/Model.hpp>
 #include <Core/Core.hpp>
 #include <Util/LayerComparator.hpp>
+#include <ThreadPool.h>
+#include <algorithm>
 
 const int WITHDRAW_THRESHOLD = core::mt::get_config_value(32, { "splitting", "splitter", "withdraw_treshold" });
+const bool ROW_HASH_GATE_ENABLE = core::mt::get_config_value(true, { "splitting", "splitter", "row_hash_gate", "enable" });
+const bool ROW_HASH_GATE_CROP = core::mt::get_config_value(false, { "splitting", "splitter", "row_hash_gate", "crop_to_changed_band" });
+const int THREAD_COUNT = core::mt::get_config_value(4, { "splitting", "splitter", "thread_count" });
 
 namespace stage
 {
 	namespace splitting
 	{
+		// Worker pool shared by the splitters of all sessions
+		static ThreadPool& get_worker_pool()
+		{
+			static ThreadPool pool(std::max(1, THREAD_COUNT));
+			return pool;
+		}
+
 		Splitter::Splitter(
 			VD(std::shared_ptr<core::visual_debug::Dump> sp_dump, )
 			std::shared_ptr<const core::VisualChangeClassifier> sp_classifier,
@@ -16,9 +28,9 @@ namespace stage
 			:
 			Work(VD(sp_dump, ) core::PrintReport(sp_log_datum_container->get_session()->get_id())), // initial empty report
 			_up_walker(std::unique_ptr<util::LogDatesWalker>(
-				new util::LogDatesWalker(sp_log_datum_container->get(), sp_log_datum_container->get_session()->get_webm_path()))),
+				new util::LogDatesWalker(sp_log_datum_container->get(), sp_log_datum_container->get_session()->get_frame_cache(), sp_log_datum_container->get_layer_arena()))),
 			_sp_classifier(sp_classifier),
-			_sp_log_dates(sp_log_datum_container->get())
+			_sp_layer_arena(sp_log_datum_container->get_layer_arena())
 		{
 			// Initialize product
 			_sp_container = std::make_shared<ProductType>(sp_log_datum_container);
@@ -36,7 +48,7 @@ namespace stage
 				// Retrieve values for that frame
 				auto sp_log_image = _up_walker->get_log_image();
 				int frame_idx = _up_walker->get_frame_idx();
-				auto layers_to_process = _up_walker->get_layer_packs();
+				auto layers_to_process = _up_walker->get_layer_packs(); // copy, layers are erased when not of interest
 
 				// Go over layers and erase those which are not of interest for now (TODO: make this more general!)
 				std::vector<int> to_be_deleted_layers;
@@ -57,110 +69,224 @@ namespace stage
 					layers_to_process.erase(layers_to_process.begin() + to_be_deleted_layers.at(i));
 				}
 
-				// Go over current intra-user states and try to match layers of current frame
-				std::vector<unsigned int> to_be_closed_states; // collect current intra-user states that can be closed
-				for (
-					unsigned int state_idx = 0;
-					state_idx < (unsigned int)_current.size();
-					++state_idx)
+				// Pixels and row hashes of layers, computed once per frame when first required (parallel to layers to process)
+				struct LayerPixels
 				{
-					// Get one current intra-user state
-					auto& r_state = _current.at(state_idx);
-					bool close_state = true;
-
-					// Get corresponding visual debug datum to fill up
-					VD(
-					std::shared_ptr<core::visual_debug::Datum> sp_datum = nullptr; // used in check for split
-					if (_sp_dump) // check whether there is a dump at all
+					bool computed = false;
+					cv::Mat pixels;
+					std::vector<std::uint64_t> row_hashes;
+				};
+				std::vector<LayerPixels> layers_pixels(layers_to_process.size());
+				auto get_layer_pixels = [&](int layer_idx) -> const LayerPixels&
+				{
+					auto& r_layer_pixels = layers_pixels.at(layer_idx);
+					if (!r_layer_pixels.computed)
 					{
-						sp_datum = _current_vd_split_checks.at(state_idx);
-					})
-
-					/////////////////////////////////////////////////
-					/// Assign a layer of the current frame to a current intra-user state
-					/////////////////////////////////////////////////
+						r_layer_pixels.pixels = sp_log_image->get_layer_pixels(layers_to_process.at(layer_idx).sptr->get_view_mask());
+						if (ROW_HASH_GATE_ENABLE) { r_layer_pixels.row_hashes = core::opencv::row_hashes(r_layer_pixels.pixels); }
+						r_layer_pixels.computed = true;
+					}
+					return r_layer_pixels;
+				};
 
-					// Retrieve latest layer in that intra-user state (the state still lives in the previous frame)
-					auto layer_access = r_state->get_layer_access(frame_idx - 1); // one frame before now
-					auto sp_latest_layer = _sp_log_dates->at(frame_idx - 1)->access_layer(layer_access); // get pointer to latest layer of that intra-user state
+				// Layers of this frame that have been assigned to an intra-user state
+				std::vector<bool> consumed_layers(layers_to_process.size(), false);
 
-					// Compare available layers of this frame with that layer from the intra-user state
+				// Decision about one current intra-user state
+				struct Decision
+				{
+					unsigned int state_idx = 0;
 					int chosen_layer = -1;
-					int idx = 0;
-					for (const auto& r_pack : layers_to_process) // go over layers of current frame
+					int scroll_x = 0;
+					int scroll_y = 0;
+					std::shared_ptr<const data::Layer> sp_latest_layer = nullptr;
+					model::Comparison comparison;
+				};
+
+				// Go over current intra-user states and try to match layers of current frame. States are decided in rounds, where
+				// the comparisons of a round run on the worker pool and are classified in one batch. A round ends before a state whose
+				// chosen layer is already chosen by an earlier state of the round, so the result is the same as when deciding one
+				// state after another
+				std::vector<unsigned int> to_be_closed_states; // collect current intra-user states that can be closed
+				unsigned int next_state_idx = 0;
+				while (next_state_idx < (unsigned int)_current.size())
+				{
+					std::vector<Decision> decisions;
+					std::vector<bool> chosen_layers(layers_to_process.size(), false);
+					for (
+						unsigned int state_idx = next_state_idx;
+						state_idx < (unsigned int)_current.size();
+						++state_idx)
 					{
-						if (util::layer_comparator::compare(r_pack.sptr, sp_latest_layer).value() > core::mt::get_config_value(0.5f, { "model", "splitting", "layer_threshold" })) // greedy, just take the first one above a certain threshold
+						// Get one current intra-user state
+						auto& r_state = _current.at(state_idx);
+
+						/////////////////////////////////////////////////
+						/// Assign a layer of the current frame to a current intra-user state
+						/////////////////////////////////////////////////
+
+						// Retrieve latest layer in that intra-user state (the state still lives in the previous frame)
+						auto layer_access = r_state->get_layer_access(frame_idx - 1); // one frame before now
+						auto sp_latest_layer = _sp_layer_arena->access_layer(frame_idx - 1, layer_access); // get pointer to latest layer of that intra-user state
+
+						// Compare available layers of this frame with that layer from the intra-user state
+						int chosen_layer = -1;
+						for (int idx = 0; idx < (int)layers_to_process.size(); ++idx) // go over layers of current frame
+						{
+							if (consumed_layers.at(idx)) { continue; }
+							if (util::layer_comparator::compare(layers_to_process.at(idx).sptr, sp_latest_layer).value() > core::mt::get_config_value(0.5f, { "model", "splitting", "layer_threshold" })) // greedy, just take the first one above a certain threshold
+							{
+								chosen_layer = idx;
+								break;
+							}
+						}
+
+						// Layer might be consumed by an earlier state of this round, decide in next round
+						if (chosen_layer >= 0 && chosen_layers.at(chosen_layer)) { break; }
+
+						Decision decision;
+						decision.state_idx = state_idx;
+						decision.chosen_layer = chosen_layer;
+						decision.comparison.result = model::Result::different; // close state if there is no layer successor
+						if (chosen_layer >= 0)
 						{
-							chosen_layer = idx;
-							break;
+							chosen_layers.at(chosen_layer) = true;
+							decision.scroll_x = (int)layers_to_process.at(chosen_layer).sptr->get_scroll_x();
+							decision.scroll_y = (int)layers_to_process.at(chosen_layer).sptr->get_scroll_y();
+							decision.sp_latest_layer = sp_latest_layer;
 						}
-						++idx;
+						decisions.push_back(std::move(decision));
 					}
 
 					/////////////////////////////////////////////////
 					/// Chech whether split is required
 					/////////////////////////////////////////////////
 
-					// There is a layer successor available in the log datum. Check whether split is now required or not
-					if (chosen_layer >= 0)
+					// Compare current pixels and data of the intra-user state and the potential data. Each decision of the round has
+					// its own state and layer, so the comparisons run on the worker pool
+					std::vector<std::future<void> > futures;
+					for (auto& r_decision : decisions)
+					{
+						if (r_decision.chosen_layer < 0) { continue; } // there is no layer successor available in the log datum
+						Decision* p_decision = &r_decision;
+						futures.push_back(get_worker_pool().enqueue([&, p_decision]()
+						{
+							// Get intra-user state and chosen layer
+							const auto& r_state = _current.at(p_decision->state_idx);
+							const auto& r_pack = layers_to_process.at(p_decision->chosen_layer);
+
+							// Get corresponding visual debug datum to fill up
+							VD(
+							std::shared_ptr<core::visual_debug::Datum> sp_datum = nullptr; // used in check for split
+							if (_sp_dump) // check whether there is a dump at all
+							{
+								sp_datum = _current_vd_split_checks.at(p_decision->state_idx);
+							})
+
+							// Potential pixels from chosen layer
+							const auto& r_layer_pixels = get_layer_pixels(p_decision->chosen_layer);
+							const auto& r_potential_pixels = r_layer_pixels.pixels;
+
+							// Find rows of potential pixels that changed since the latest frame of the intra-user state (aligned by scrolling)
+							int band_begin = 0, band_end = r_potential_pixels.rows;
+							bool changed = !ROW_HASH_GATE_ENABLE || model::find_changed_rows(
+								r_state->get_latest_row_hashes(),
+								r_state->get_latest_x_offset(),
+								r_state->get_latest_y_offset(),
+								r_layer_pixels.row_hashes,
+								p_decision->scroll_x,
+								p_decision->scroll_y,
+								band_begin,
+								band_end);
+
+							// The gate compares against the latest frame, whereas the split model compares against the stitched screenshot,
+							// i.e., a vote over the pixel history. Unchanged rows are only accepted as same when they are not all transparent
+							// (rows are equal to the rows of the latest frame, so that frame had non-zero alpha in them, too). Otherwise, the
+							// split model decides, e.g., that there is no overlap with a transparent layer
+							if (!changed)
+							{
+								cv::Mat alpha;
+								cv::extractChannel(r_potential_pixels, alpha, 3);
+								changed = cv::countNonZero(alpha) <= 0;
+								if (changed)
+								{
+									band_begin = 0; // band of changed rows is empty, compare all rows
+									band_end = r_potential_pixels.rows;
+								}
+							}
+
+							// Unchanged pixels are the same
+							p_decision->comparison.result = model::Result::same;
+							if (changed)
+							{
+								// Create rect that represents potential pixels in current pixels space
+								cv::Rect rect(p_decision->scroll_x, p_decision->scroll_y, r_potential_pixels.cols, r_potential_pixels.rows);
+
+								// Get portion of stitched screenshot corresponding to potential new pixels, with emptyness where the stitched screenshot ends
+								cv::Mat transformed_current_pixels =
+									r_state->get_stitched_screenshot_roi(rect);
+
+								// Compare either all rows or only the changed ones
+								cv::Rect band(0, 0, r_potential_pixels.cols, r_potential_pixels.rows);
+								if (ROW_HASH_GATE_CROP)
+								{
+									band = cv::Rect(0, band_begin, r_potential_pixels.cols, band_end - band_begin);
+								}
+								p_decision->comparison = model::prepare(
+									VD(sp_datum, ) // visual debug datum to add on
+									transformed_current_pixels(band), // current pixels, already transformed accordingly to potential pixels
+									p_decision->sp_latest_layer, // current layer
+									r_potential_pixels(band), // potential pixels to compare against
+									r_pack.sptr // potential layer to compare against
+								);
+							}
+							VD(if (!changed && sp_datum) { sp_datum->add(vd_strings("Split Model: ")->add("skipped, rows unchanged since latest frame")); })
+						}));
+					}
+					for (auto& r_future : futures)
+					{
+						r_future.wait(); // decisions must outlive all comparisons, even if one throws
+					}
+					for (auto& r_future : futures)
 					{
-						// Prepare values
-						const auto& r_pack = layers_to_process.at(chosen_layer);
-						int scroll_x = (int)r_pack.sptr->get_scroll_x();
-						int scroll_y = (int)r_pack.sptr->get_scroll_y();
-
-						// Potential pixels from chosen layer
-						auto potential_pixels = sp_log_image->get_layer_pixels(r_pack.sptr->get_view_mask());
-
-						// Create rect that represents potential pixels in current pixels space
-						cv::Rect rect(scroll_x, scroll_y, potential_pixels.cols, potential_pixels.rows);
-
-						// Extend cloned stitched screenshot from intra-user state with some emptyness if required
-						cv::Mat stitched_screenshot_clone = r_state->get_stitched_screenshot().clone();
-						core::opencv::extend(stitched_screenshot_clone, rect);
-
-						// Get portion of stitched screenshot corresponding to potential new pixels
-						cv::Mat transformed_current_pixels =
-							stitched_screenshot_clone(rect);
-
-						// Compare current pixels and data of the intra-user state and the potential data
-						model::Result split_result = model::compute(
-							VD(sp_datum, ) // visual debug datum to add on
-							_sp_classifier, // classifier of visual change
-							transformed_current_pixels, // current pixels, already transformed accordingly to potential pixels
-							sp_latest_layer, // current layer
-							potential_pixels, // potential pixels to compare against
-							r_pack.sptr // potential layer to compare against
-						);
+						r_future.get(); // rethrows exceptions of the comparison
+					}
+
+					// Classify pending comparisons of this round in one batch
+					std::vector<model::Comparison*> comparisons;
+					for (auto& r_decision : decisions)
+					{
+						comparisons.push_back(&r_decision.comparison);
+					}
+					model::classify(_sp_classifier, comparisons);
+
+					// Apply decisions in order of the states
+					for (const auto& r_decision : decisions)
+					{
+						auto& r_state = _current.at(r_decision.state_idx);
 
 						// If no split required, add frame to intra-use state
-						if(split_result == model::Result::same)
+						if (r_decision.comparison.result == model::Result::same)
 						{
 							// Push this frame onto the intra-user state
+							const auto& r_layer_pixels = get_layer_pixels(r_decision.chosen_layer);
 							r_state->add_frame(
-								r_pack.access, // access to layer
-								potential_pixels, // new pixels
-								scroll_x, // x-offset of pixels
-								scroll_y); // y-offset of pixels
+								layers_to_process.at(r_decision.chosen_layer).access, // access to layer
+								r_layer_pixels.pixels, // new pixels
+								r_decision.scroll_x, // x-offset of pixels
+								r_decision.scroll_y); // y-offset of pixels
+							r_state->set_latest_row_hashes(r_layer_pixels.row_hashes);
 
 							// Remove the layer from the ones to be processed
-							layers_to_process.erase(layers_to_process.begin() + chosen_layer);
-
-							// Remember not to close state as it is still alive and extended
-							close_state = false;
+							consumed_layers.at(r_decision.chosen_layer) = true;
 						}
-						else if(split_result == model::Result::no_overlap) // special case: there was no overlap
+						else // the layer is not considered as successor and intra-user state is closed
 						{
-							// TODO: use this information somehow? right now, "no_overlap" and "different" are treated the same
+							// TODO: use "no_overlap" somehow? right now, "no_overlap" and "different" are treated the same
+							to_be_closed_states.push_back(r_decision.state_idx);
 						}
-					} // end of state extension
-
-					// Decide whether to close state or not
-					if (close_state)
-					{
-						// The layer is not considered as successor and intra-user state is closed
-						to_be_closed_states.push_back(state_idx);
 					}
+					next_state_idx += (unsigned int)decisions.size();
 
 				} // end of iteration over current states
 
@@ -176,14 +302,18 @@ namespace stage
 				/////////////////////////////////////////////////
 
 				// Go over layers not yet mapped layers and initiate a new intra-user state each
-				for (const auto& r_pack : layers_to_process)
+				for (int layer_idx = 0; layer_idx < (int)layers_to_process.size(); ++layer_idx)
 				{
+					if (consumed_layers.at(layer_idx)) { continue; }
+
 					// Prepare values
+					const auto& r_pack = layers_to_process.at(layer_idx);
 					int scroll_x = (int)r_pack.sptr->get_scroll_x();
 					int scroll_y = (int)r_pack.sptr->get_scroll_y();
 
 					// Pixels from chosen layer
-					auto layer_pixels = sp_log_image->get_layer_pixels(r_pack.sptr->get_view_mask());
+					const auto& r_layer_pixels = get_layer_pixels(layer_idx);
+					auto layer_pixels = r_layer_pixels.pixels;
 
 					// Create new intra-user state
 					auto up_state = std::unique_ptr<data::IntraUserState>(
@@ -194,6 +324,7 @@ namespace stage
 							layer_pixels, // initial pixels
 							scroll_x, // x-offset of pixels
 							scroll_y)); // y-offset of pixels
+					up_state->set_latest_row_hashes(r_layer_pixels.row_hashes);
 					_current.push_back(std::move(up_state));
 
 					// Add corresponding visual debug datum to the vector for visual debug datums per intra-user state
@@ -241,7 +372,7 @@ namespace stage
 				auto idx_start = _current.at(current_idx)->get_frame_idx_start();
 				auto idx_end = _current.at(current_idx)->get_frame_idx_end();
 				auto layer_access = _current.at(current_idx)->get_layer_access(idx_start);
-				std::string xpath = _sp_log_dates->at(idx_start)->access_layer(layer_access)->get_xpath();
+				std::string xpath = _sp_layer_arena->access_layer(idx_start, layer_access)->get_xpath();
 				for (unsigned int i = idx_start; i <= idx_end; ++i)
 				{
 					_sp_container->add_empty_frame(xpath, i);
@@ -254,13 +385,14 @@ namespace stage
 			else // push state into product
 			{
 				// There is sometimes a single opaque pixel in the left upper corner. It is removed here (or TODO: find out the actual issue causing the pixel to exist)
-				auto mat = _current.at(current_idx)->get_stitched_screenshot().clone();
-				if(mat.rows > 0 && mat.cols > 1)
+				auto size = _current.at(current_idx)->get_stitched_screenshot_size();
+				if(size.height > 0 && size.width > 1)
 				{
-					if(mat.at<cv::Vec4b>(0, 1)[3] == 0)
+					cv::Mat corner = _current.at(current_idx)->get_stitched_screenshot_roi(cv::Rect(0, 0, 2, 1)).clone();
+					if(corner.at<cv::Vec4b>(0, 1)[3] == 0 && corner.at<cv::Vec4b>(0, 0)[3] != 0)
 					{
-						mat.at<cv::Vec4b>(0, 0)[3] = 0;
-						_current.at(current_idx)->set_stitched_screenshot(mat);
+						corner.at<cv::Vec4b>(0, 0)[3] = 0;
+						_current.at(current_idx)->write_stitched_screenshot(cv::Rect(0, 0, 1, 1), corner(cv::Rect(0, 0, 1, 1)));
 					}
 				}
 			
@@ -51,7 +51,7 @@ namespace stage
 			// Members
 			std::unique_ptr<util::LogDatesWalker> _up_walker = nullptr; // walks over log dates
 			std::shared_ptr<const core::VisualChangeClassifier> _sp_classifier = nullptr;
-			std::shared_ptr<data::LogDates_const> _sp_log_dates = nullptr; // pointer to log dates
+			std::shared_ptr<const data::LayerArena> _sp_layer_arena = nullptr; // flat layer trees of log dates, to access layers of intra-user states
 			std::vector<std::unique_ptr<data::IntraUserState> > _current; // currently processed intra-user states
 			VD(std::vector<std::shared_ptr<core::visual_debug::Datum> > _current_vd_split_checks;) // handled parallel to _current
 		};
@@ -48,9 +48,9 @@ namespace util
 					// Check whether weak pointer could be made shared
 					if (sp_intra_a_container && sp_intra_b_container)
 					{
-						// Get log dates
-						auto sp_log_dates_a = sp_intra_a_container->get_log_datum_container();
-						auto sp_log_dates_b = sp_intra_b_container->get_log_datum_container();
+						// Get flat layer trees of log dates
+						auto sp_arena_a = sp_intra_a_container->get_log_datum_container()->get_layer_arena();
+						auto sp_arena_b = sp_intra_b_container->get_log_datum_container()->get_layer_arena();
 
 						// Go over all frames of both intra-user states and compare layers
 						util::ScoreAcc<> score_acc;
@@ -59,13 +59,13 @@ namespace util
 							idx_a <= sp_intra_a->get_frame_idx_end();
 							++idx_a)
 						{
-							auto sp_layer_a = sp_log_dates_a->get()->at(idx_a)->access_layer(sp_intra_a->get_layer_access(idx_a));
+							auto sp_layer_a = sp_arena_a->access_layer(idx_a, sp_intra_a->get_layer_access(idx_a));
 							for (
 								unsigned int idx_b = sp_intra_b->get_frame_idx_start();
 								idx_b <= sp_intra_b->get_frame_idx_end();
 								++idx_b)
 							{
-								auto sp_layer_b = sp_log_dates_b->get()->at(idx_b)->access_layer(sp_intra_b->get_layer_access(idx_b));
+								auto sp_layer_b = sp_arena_b->access_layer(idx_b, sp_intra_b->get_layer_access(idx_b));
 
 								// Compare both layers and accumulate score
 								score_acc.push_back(util::layer_comparator::compare(sp_layer_a, sp_layer_b));
@@ -4,7 +4,7 @@ namespace util
 {
 	namespace layer_comparator
 	{
-		Score<> compare(std::shared_ptr<const data::Layer> a, std::shared_ptr<const data::Layer> b)
+		Score<> compare(const std::shared_ptr<const data::Layer>& a, const std::shared_ptr<const data::Layer>& b)
 		{
 			Score<> score;
 
@@ -14,7 +14,7 @@ namespace util
 				score.add(0.5f); // might lead to merge different layers of same type for no reason
 			*/
 
-			if (a->get_xpath() == b->get_xpath())
+			if (a->get_xpath_id() == b->get_xpath_id()) // xpaths are interned
 			{
 				score.add(1.0f);
 			}
@@ -18,6 +18,6 @@ namespace util
 	namespace layer_comparator
 	{
 		// Returns similiarity score of two layers
-		Score<> compare(std::shared_ptr<const data::Layer> a, std::shared_ptr<const data::Layer> b);
+		Score<> compare(const std::shared_ptr<const data::Layer>& a, const std::shared_ptr<const data::Layer>& b);
 	}
 }
\ No newline at end of file
@@ -1,92 +1,220 @@
 #include "LogDatesWalker.hpp"
-#include <deque>
+#include <Core/Core.hpp>
+#include <stdexcept>
+#include <algorithm>
+
+const int PREFETCH_DEPTH = core::mt::get_config_value(4, { "general", "log_dates_walker", "prefetch_depth" });
 
 namespace util
 {
 	LogDatesWalker::LogDatesWalker(
 		std::shared_ptr<data::LogDates_const> sp_log_dates,
-		std::string webm_path)
+		std::string webm_path,
+		std::shared_ptr<const data::LayerArena> sp_layer_arena)
 		:
 		_sp_log_dates(sp_log_dates), // log dates
-		_frame_count((unsigned int) sp_log_dates->size()) // frame count is set to number of log dates (might be limited by user)
+		_sp_layer_arena(sp_layer_arena), // flat layer trees
+		_frame_count((unsigned int) sp_log_dates->size()), // frame count is set to number of log dates (might be limited by user)
+		_prefetch_depth((unsigned int) std::max(0, PREFETCH_DEPTH))
 	{
 		if (!webm_path.empty())
 		{
-			_up_video_walker = simplewebm::create_video_walker(webm_path); // video walker to extract screenshots
+			_sp_frame_cache = std::make_shared<data::FrameCache>(webm_path, 1, 0); // private cache without spilling, frames are walked only once
+			_sp_frame_cache->attach_walker();
+		}
+	}
+
+	LogDatesWalker::LogDatesWalker(
+		std::shared_ptr<data::LogDates_const> sp_log_dates,
+		std::shared_ptr<data::FrameCache> sp_frame_cache,
+		std::shared_ptr<const data::LayerArena> sp_layer_arena)
+		:
+		_sp_log_dates(sp_log_dates), // log dates
+		_sp_frame_cache(sp_frame_cache), // frame cache to extract screenshots
+		_sp_layer_arena(sp_layer_arena), // flat layer trees
+		_frame_count((unsigned int) sp_log_dates->size()), // frame count is set to number of log dates (might be limited by user)
+		_prefetch_depth((unsigned int) std::max(0, PREFETCH_DEPTH))
+	{
+		if (_sp_frame_cache)
+		{
+			_sp_frame_cache->attach_walker();
+		}
+	}
+
+	LogDatesWalker::~LogDatesWalker()
+	{
+		stop_prefetching();
+		if (_sp_frame_cache)
+		{
+			_sp_frame_cache->detach_walker(); // frames are released when no other walker is attached
 		}
 	}
 
 	bool LogDatesWalker::step()
 	{
-		int frame_idx = _frame_idx + 1;
-		if (frame_idx < (int) _frame_count)
+		return seek((unsigned int)(_frame_idx + 1));
+	}
+
+	bool LogDatesWalker::seek(unsigned int frame_idx)
+	{
+		if (frame_idx < _frame_count)
 		{
 			// Fetch log datum
 			_sp_log_datum = _sp_log_dates->at(frame_idx);
 
 			// Fetch log image
-			if (_up_video_walker)
+			if (_sp_frame_cache)
 			{
-				// Fetch screenshot of that frame from screencast
-				auto sp_images = std::shared_ptr<std::vector<simplewebm::Image> >(new std::vector<simplewebm::Image>);
-				_up_video_walker->walk(sp_images, 1);
-
-				// Create log image
-				_sp_log_image = std::shared_ptr<data::LogImage>(new data::LogImage(sp_images->at(0), _sp_log_datum));
+				_sp_log_image = fetch_log_image(frame_idx);
 			}
 
 			// Take over frame_idx
-			_frame_idx = frame_idx;
+			_frame_idx = (int)frame_idx;
 
-			return true; // next frame has been available
+			return true; // frame has been available
 		}
 		else
 		{
-			return false; // already reached end of frames
+			return false; // frame is beyond end of frames
 		}
 	}
 
-	std::shared_ptr<const data::LogImage> LogDatesWalker::get_log_image() const
+	std::shared_ptr<const data::LogImage> LogDatesWalker::create_log_image(unsigned int frame_idx) const
 	{
-		return _sp_log_image;
+		// Fetch screenshot of that frame from screencast
+		auto sp_image = _sp_frame_cache->get(frame_idx);
+		if (!sp_image)
+		{
+			throw std::runtime_error("Screencast has no frame " + std::to_string(frame_idx) + ": " + _sp_frame_cache->get_webm_path());
+		}
+
+		// Create log image
+		return std::shared_ptr<data::LogImage>(new data::LogImage(sp_image, _sp_log_dates->at(frame_idx)));
 	}
 
-	std::shared_ptr<const data::LogDatum> LogDatesWalker::get_log_datum() const
+	std::shared_ptr<const data::LogImage> LogDatesWalker::fetch_log_image(unsigned int frame_idx)
 	{
-		return _sp_log_datum;
+		// Create log image synchronously
+		if (_prefetch_depth == 0)
+		{
+			return create_log_image(frame_idx);
+		}
+
+		// Stop producer thread when jumping backward or beyond the prefetched log images
+		const unsigned int next_frame_idx = (unsigned int)(_frame_idx + 1);
+		if (frame_idx < next_frame_idx || frame_idx > next_frame_idx + _prefetch_depth)
+		{
+			stop_prefetching();
+		}
+
+		// Start producer thread when not yet running
+		if (!_prefetch_thread.joinable())
+		{
+			start_prefetching(frame_idx);
+		}
+
+		// Wait for the log image to be prefetched
+		std::pair<unsigned int, std::shared_ptr<const data::LogImage> > entry;
+		do
+		{
+			{
+				std::unique_lock<std::mutex> lock(_prefetch_mutex);
+				_prefetch_produced.wait(lock, [&] { return !_prefetched.empty() || _prefetch_exception; });
+				if (_prefetched.empty())
+				{
+					std::rethrow_exception(_prefetch_exception);
+				}
+				entry = _prefetched.front();
+				_prefetched.pop_front();
+			}
+			_prefetch_consumed.notify_one();
+		} while (entry.first < frame_idx); // skip prefetched log images when jumping forward
+
+		// Producer is already beyond the requested frame, thus restart it there
+		if (entry.first != frame_idx)
+		{
+			stop_prefetching();
+			return fetch_log_image(frame_idx);
+		}
+		return entry.second;
 	}
 
-	std::vector<LayerPack> LogDatesWalker::get_layer_packs() const
+	void LogDatesWalker::start_prefetching(unsigned int frame_idx)
 	{
-		// Determine how to access layers of that frame
-		std::vector<LayerPack> layer_packs;
-		if(_sp_log_datum != nullptr)
+		_prefetch_stop = false;
+		_prefetch_exception = nullptr;
+		_prefetch_thread = std::thread([this, frame_idx]()
 		{
-			std::deque<LayerPack> layers_to_collect;
-			layers_to_collect.push_back(LayerPack({}, _sp_log_datum->get_root())); // push back root layer
-			while (!layers_to_collect.empty())
+			try
 			{
-				// Get layer pack from the front of the queue
-				auto pack = layers_to_collect.front();
-				layers_to_collect.pop_front();
-
-				// Go over children of the front layer and add them to the queue
-				auto child_count = pack.sptr->get_child_count();
-				for (unsigned int child_idx = 0; child_idx < child_count; ++child_idx)
+				for (unsigned int idx = frame_idx; idx < _frame_count; ++idx)
 				{
-					// Push back layers to process
-					LayerPack child_pack(
-						pack.access, // access indices
-						pack.sptr->get_child(child_idx)); // pointer
-					child_pack.access.push_back(child_idx); // push back index how to access that child
-					layers_to_collect.push_back(child_pack);
+					// Wait for space in the buffer
+					{
+						std::unique_lock<std::mutex> lock(_prefetch_mutex);
+						_prefetch_consumed.wait(lock, [&] { return _prefetch_stop || _prefetched.size() < _prefetch_depth; });
+						if (_prefetch_stop) { return; }
+					}
+
+					// Decode and convert frame
+					auto sp_log_image = create_log_image(idx);
+
+					// Hand over log image to consumer
+					{
+						std::lock_guard<std::mutex> lock(_prefetch_mutex);
+						_prefetched.push_back({ idx, sp_log_image });
+					}
+					_prefetch_produced.notify_one();
 				}
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(_prefetch_mutex);
+				_prefetch_exception = std::current_exception();
+			}
+			_prefetch_produced.notify_one();
+		});
+	}
 
-				// Add pop'd layer to layers to output
-				layer_packs.push_back(pack);
+	void LogDatesWalker::stop_prefetching()
+	{
+		if (_prefetch_thread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(_prefetch_mutex);
+				_prefetch_stop = true;
 			}
+			_prefetch_consumed.notify_one();
+			_prefetch_thread.join();
+		}
+		_prefetched.clear();
+	}
+
+	std::shared_ptr<const data::LogImage> LogDatesWalker::get_log_image() const
+	{
+		return _sp_log_image;
+	}
+
+	std::shared_ptr<const data::LogDatum> LogDatesWalker::get_log_datum() const
+	{
+		return _sp_log_datum;
+	}
+
+	const data::LayerPacks& LogDatesWalker::get_layer_packs() const
+	{
+		// No layers before walk
+		static const data::LayerPacks empty;
+		if (_sp_log_datum == nullptr)
+		{
+			return empty;
+		}
+
+		// Layer packs of all frames are tabulated at once by the arena
+		if (_sp_layer_arena == nullptr)
+		{
+			_sp_layer_arena = std::make_shared<data::LayerArena>(*_sp_log_dates);
 		}
-		return layer_packs;
+		return _sp_layer_arena->get_layer_packs((unsigned int)_frame_idx);
 	}
 
 	int LogDatesWalker::get_frame_idx() const
@@ -1,25 +1,24 @@
 //! Log dates walker.
 /*!
 Log dates walker walks over log dates and serves corresponding data like layer and screenshot data.
+Screenshots can be prefetched by a producer thread, which decodes and converts frames ahead of the consumer.
 */
 
 #pragma once
 
 #include <Data/LogImage.hpp>
 #include <Data/LogDatum.hpp>
-#include <libsimplewebm.hpp>
+#include <Data/FrameCache.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 
 namespace util
 {
-	// Struct to store how to access a layer via indices for general and the direct pointer for local processing
-	struct LayerPack
-	{
-		LayerPack(std::vector<unsigned int> access, std::shared_ptr<const data::Layer> sptr) :
-			access(access), sptr(sptr) {}
-
-		std::vector<unsigned int> access; // empty for root
-		std::shared_ptr<const data::Layer> sptr; // should be only used for local actions, not easy serializable
-	};
+	// Layer packs are tabulated by the layer arena
+	typedef data::LayerPack LayerPack;
 
 
 	// Class to walk over log dates and corresponding log images in screencast
@@ -28,22 +27,40 @@ namespace util
 	public:
 
 		// Constructor. On needs to walk one frame before values can be retrieved.
-		// If no webm_path is provided, log images are not available
+		// If no webm_path is provided, log images are not available.
+		// If no layer arena is provided, one is created from the log dates when layer packs are first requested
 		LogDatesWalker(
 			std::shared_ptr<data::LogDates_const> sp_log_dates, // processed datacast
-			std::string webm_path = ""); // path to screencast
+			std::string webm_path = "", // path to screencast
+			std::shared_ptr<const data::LayerArena> sp_layer_arena = nullptr); // flat layer trees of log dates, e.g., the one of the container
+
+		// Constructor. Screenshots are served by the provided frame cache, e.g., the one of the session, which keeps its frames
+		// in memory while walkers are attached. If no frame cache is provided, log images are not available
+		LogDatesWalker(
+			std::shared_ptr<data::LogDates_const> sp_log_dates, // processed datacast
+			std::shared_ptr<data::FrameCache> sp_frame_cache, // decoded screencast
+			std::shared_ptr<const data::LayerArena> sp_layer_arena = nullptr); // flat layer trees of log dates, e.g., the one of the container
+
+		// Destructor, stops prefetching and detaches from the frame cache
+		~LogDatesWalker();
 
 		// Walks one frame. Returns true when frame has been available, otherwise false
 		bool step();
 
+		// Jumps to a frame. Returns true when frame has been available, otherwise false and values are kept.
+		// Screenshots of frames still held by the frame cache are served without decoding, other frames are decoded from
+		// the current position of the decoder, or from the start of the screencast if the decoder is already past the frame.
+		// As the screencast has no keyframe index, jumping forward still decodes the skipped frames, but does not convert them
+		bool seek(unsigned int frame_idx);
+
 		// Get log image of last walked frame (nullptr before walk)
 		std::shared_ptr<const data::LogImage> get_log_image() const;
 
 		// Get log datum of last walked frame (nullptr before walk)
 		std::shared_ptr<const data::LogDatum> get_log_datum() const;
 
-		// Get layers to be processed for this frame
-		std::vector<LayerPack> get_layer_packs() const;
+		// Get layers to be processed for this frame. Table is shared read-only, valid as long as the walker exists
+		const data::LayerPacks& get_layer_packs() const;
 
 		// Get current frame idx (-1 before walk)
 		int get_frame_idx() const;
@@ -53,14 +70,41 @@ namespace util
 
 	private:
 
+		// Remove copy and assignment operators
+		LogDatesWalker(const LogDatesWalker&) = delete;
+		LogDatesWalker& operator=(const LogDatesWalker&) = delete;
+
+		// Create log image of a frame. Throws if screencast has no such frame
+		std::shared_ptr<const data::LogImage> create_log_image(unsigned int frame_idx) const;
+
+		// Fetch log image of a frame, either from the prefetched ones or created synchronously
+		std::shared_ptr<const data::LogImage> fetch_log_image(unsigned int frame_idx);
+
+		// Start producer thread that prefetches log images beginning with frame_idx
+		void start_prefetching(unsigned int frame_idx);
+
+		// Stop producer thread and discard prefetched log images
+		void stop_prefetching();
+
 		// Members
 		std::shared_ptr<data::LogDates_const> _sp_log_dates = nullptr;
-		std::unique_ptr<simplewebm::VideoWalker> _up_video_walker = nullptr;
+		std::shared_ptr<data::FrameCache> _sp_frame_cache = nullptr;
+		mutable std::shared_ptr<const data::LayerArena> _sp_layer_arena = nullptr; // created on demand if not provided
 		const unsigned int _frame_count;
 
 		// Members holding current values
 		int _frame_idx = -1;
 		std::shared_ptr<const data::LogDatum> _sp_log_datum = nullptr;
 		std::shared_ptr<const data::LogImage> _sp_log_image = nullptr;
+
+		// Members for prefetching
+		const unsigned int _prefetch_depth; // zero if log images are created synchronously
+		std::thread _prefetch_thread;
+		std::mutex _prefetch_mutex;
+		std::condition_variable _prefetch_produced;
+		std::condition_variable _prefetch_consumed;
+		std::deque<std::pair<unsigned int, std::shared_ptr<const data::LogImage> > > _prefetched; // bounded by prefetch depth
+		std::exception_ptr _prefetch_exception = nullptr; // set when producer failed
+		bool _prefetch_stop = false;
 	};
 }